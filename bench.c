@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "emu/gbcore.h"
+
+typedef struct {
+  const char *rom; /* NULL for the boot ROM alone */
+  uint64_t frames;
+  uint64_t instructions;
+  uint64_t cycles;
+  double seconds;
+} Result;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void countInstruction(GB *gb, void *user) {
+  (void)gb;
+  (*(uint64_t *)user)++;
+}
+
+static int bench(Result *result, uint64_t frames) {
+  GB *gb = gbNew();
+  if (gb == NULL)
+    return 1;
+  if (result->rom != NULL && gbLoadRomFile(gb, result->rom) != 0) {
+    gbFree(gb);
+    return 1;
+  }
+
+  double start = now();
+  for (uint64_t i = 0; i < frames; i++)
+    gbRunFrameWith(gb, countInstruction, &result->instructions);
+  result->seconds = now() - start;
+  result->frames = frames;
+  result->cycles = gb->cycles;
+
+  gbFree(gb);
+  return 0;
+}
+
+static long peakRss(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss; /* KB on Linux */
+}
+
+static const char *romName(const Result *result) {
+  return result->rom != NULL ? result->rom : "(boot rom)";
+}
+
+static void printHuman(const Result *results, int count) {
+  printf("%-32s %10s %12s %10s %10s\n", "rom", "frames", "frames/s", "MIPS",
+         "cycles/ns");
+  for (int i = 0; i < count; i++) {
+    const Result *r = &results[i];
+    printf("%-32s %10llu %12.1f %10.2f %10.4f\n", romName(r),
+           (unsigned long long)r->frames, r->frames / r->seconds,
+           r->instructions / r->seconds / 1e6, r->cycles / r->seconds / 1e9);
+  }
+  printf("peak RSS: %ld KB\n", peakRss());
+}
+
+static void printJsonString(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\')
+      fputc('\\', f);
+    fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+static void printJson(FILE *f, const Result *results, int count) {
+  fprintf(f, "{\n  \"version\": \"%d.%d\",\n  \"results\": [\n",
+          GB_CORE_VERSION_MAJOR, GB_CORE_VERSION_MINOR);
+  for (int i = 0; i < count; i++) {
+    const Result *r = &results[i];
+    fprintf(f, "    {\"rom\": ");
+    printJsonString(f, romName(r));
+    fprintf(f,
+            ", \"frames\": %llu, \"instructions\": %llu, "
+            "\"cycles\": %llu, \"seconds\": %.6f, \"frames_per_second\": "
+            "%.3f, \"instructions_per_second\": %.0f, "
+            "\"cycles_per_ns\": %.6f}%s\n",
+            (unsigned long long)r->frames,
+            (unsigned long long)r->instructions,
+            (unsigned long long)r->cycles, r->seconds, r->frames / r->seconds,
+            r->instructions / r->seconds, r->cycles / r->seconds / 1e9,
+            i + 1 < count ? "," : "");
+  }
+  fprintf(f, "  ],\n  \"peak_rss_kb\": %ld\n}\n", peakRss());
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-n frames] [-j out.json] [rom...]\n"
+          "  -n  frames to emulate per ROM (default 3600)\n"
+          "  -j  also write the results as JSON, - for stdout\n"
+          "The boot ROM on its own is always benchmarked first.\n",
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t frames = 3600;
+  const char *json = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:j:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      frames = strtoull(optarg, NULL, 10);
+      break;
+    case 'j':
+      json = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (frames == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  int count = argc - optind + 1;
+  Result *results = calloc((size_t)count, sizeof(Result));
+  if (results == NULL) {
+    printf("out of memory\n");
+    return 1;
+  }
+  for (int i = 1; i < count; i++)
+    results[i].rom = argv[optind + i - 1];
+
+  for (int i = 0; i < count; i++) {
+    if (bench(&results[i], frames) != 0) {
+      printf("%s: %s\n", romName(&results[i]), gbGetError());
+      free(results);
+      return 1;
+    }
+  }
+
+  if (json == NULL || strcmp(json, "-") != 0)
+    printHuman(results, count);
+  if (json != NULL) {
+    FILE *f = strcmp(json, "-") == 0 ? stdout : fopen(json, "w");
+    if (f == NULL) {
+      printf("cannot open %s\n", json);
+      free(results);
+      return 1;
+    }
+    printJson(f, results, count);
+    if (f != stdout)
+      fclose(f);
+  }
+
+  free(results);
+  return 0;
+}
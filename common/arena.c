@@ -0,0 +1,78 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+
+#define ALIGN _Alignof(max_align_t)
+#define HEADER ((sizeof(GBArenaBlock) + ALIGN - 1) & ~(ALIGN - 1))
+
+static GBArenaBlock *newBlock(size_t size, GBArenaBlock *next) {
+  GBArenaBlock *block = malloc(HEADER + size);
+  if (block == NULL)
+    return NULL;
+  block->next = next;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+GBArena *gbArenaNew(size_t size) {
+  GBArena *arena = malloc(sizeof(GBArena));
+  if (arena == NULL || (arena->block = newBlock(size, NULL)) == NULL) {
+    gbSetError("<<gbArenaNew>> cannot allocate %zu bytes", size);
+    free(arena);
+    return NULL;
+  }
+  arena->used = arena->peak = 0;
+  return arena;
+}
+
+static void freeBlocks(GBArenaBlock *block) {
+  while (block != NULL) {
+    GBArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+void gbArenaFree(GBArena *arena) {
+  freeBlocks(arena->block);
+  free(arena);
+}
+
+void *gbArenaAlloc(GBArena *arena, size_t size) {
+  size = (size + ALIGN - 1) & ~(ALIGN - 1);
+  GBArenaBlock *block = arena->block;
+  if (block->size - block->used < size) {
+    size_t grown = block->size * 2 > size ? block->size * 2 : size;
+    if ((block = newBlock(grown, arena->block)) == NULL) {
+      gbSetError("<<gbArenaAlloc>> cannot allocate %zu bytes", grown);
+      return NULL;
+    }
+    arena->block = block;
+  }
+
+  void *p = (char *)block + HEADER + block->used;
+  block->used += size;
+  arena->used += size;
+  if (arena->used > arena->peak)
+    arena->peak = arena->used;
+  memset(p, 0, size);
+  return p;
+}
+
+void gbArenaReset(GBArena *arena) {
+  GBArenaBlock *block = arena->block;
+  if (block->next != NULL) {
+    /* overflowed: replace the chain with one block that fits the peak */
+    GBArenaBlock *merged = newBlock(arena->peak, NULL);
+    if (merged != NULL) {
+      freeBlocks(block);
+      block = arena->block = merged;
+    }
+  }
+  block->used = 0;
+  arena->used = 0;
+}
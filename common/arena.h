@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for scratch memory that lives until the next gbArenaReset,
+ * typically one UI frame. Allocation is a pointer bump; when the block runs
+ * out an overflow block is malloc'd, and the next reset folds everything into
+ * one block sized for the peak, so a steady frame loop stops calling malloc
+ * after its first frames. Nothing is freed individually.
+ */
+
+typedef struct GBArenaBlock {
+  struct GBArenaBlock *next; /* older overflow blocks */
+  size_t size;
+  size_t used;
+  /* payload follows */
+} GBArenaBlock;
+
+typedef struct {
+  GBArenaBlock *block; /* current, the only one after a reset */
+  size_t used;         /* across all blocks since the last reset */
+  size_t peak;
+} GBArena;
+
+GBArena *gbArenaNew(size_t size);
+void gbArenaFree(GBArena *arena);
+
+/* Zeroed, aligned for any type. NULL only when malloc fails */
+void *gbArenaAlloc(GBArena *arena, size_t size);
+
+void gbArenaReset(GBArena *arena);
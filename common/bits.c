@@ -1,7 +1,5 @@
 #include "bits.h"
 
-#include <string.h>
-
 byte setBit(byte n, small pos) {
   n |= (1 << pos);
   return n;
@@ -16,14 +14,11 @@ bool testBit(byte n, small pos) { return ((n) & (1 << (pos))) > 0; }
 
 byte getVal(byte n, small pos) { return ((n >> pos) & 1); }
 
-char *fmtByte(byte n) {
-  static char b[9];
-  b[0] = '\0';
-
-  int z;
-  for (z = 128; z > 0; z >>= 1) {
-    strcat(b, ((n & z) == z) ? "1" : "0");
-  }
+char *fmtByte(byte n, char buf[GB_FMT_BYTE_LEN]) {
+  int i = 0;
+  for (int z = 128; z > 0; z >>= 1)
+    buf[i++] = ((n & z) == z) ? '1' : '0';
+  buf[i] = '\0';
 
-  return b;
+  return buf;
 }
\ No newline at end of file
@@ -14,4 +14,6 @@ bool testBit(byte n, small pos);
 
 byte getVal(byte n, small pos);
 
-char *fmtByte(byte n);
\ No newline at end of file
+/* Formats n as 8 binary digits into buf, which must hold GB_FMT_BYTE_LEN */
+#define GB_FMT_BYTE_LEN 9
+char *fmtByte(byte n, char buf[GB_FMT_BYTE_LEN]);
\ No newline at end of file
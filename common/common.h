@@ -2,5 +2,10 @@
 
 #include <stdbool.h>
 
+#include "arena.h"
 #include "bits.h"
-#include "error.h"
\ No newline at end of file
+#include "error.h"
+#include "profile.h"
+#include "ring.h"
+#include "trace.h"
+#include "writer.h"
\ No newline at end of file
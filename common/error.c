@@ -5,7 +5,9 @@
 #include <stdlib.h>
 
 GBError *gbGetErrorBuffer(void) {
-  static GBError error;
+  /* One buffer per thread so cores running in parallel don't clobber each
+   * other's errors */
+  static _Thread_local GBError error;
   return &error;
 }
 
@@ -0,0 +1,168 @@
+#include "profile.h"
+
+const char *const gbProfileZoneNames[GB_PROFILE_COUNT] = {
+    "cpu", "mem", "timer", "ppu", "apu", "upload", "imgui", "swap",
+};
+
+#ifdef GB_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICKS() __rdtsc()
+#else
+#define TICKS() nanoseconds()
+#endif
+
+#include "error.h"
+
+#define MAX_DEPTH 16
+
+typedef struct {
+  /* open zones */
+  int stack[MAX_DEPTH];
+  uint64_t start[MAX_DEPTH];
+  int depth;
+  int overflow; /* zones begun past MAX_DEPTH, charged to the innermost */
+
+  uint64_t ticks[GB_PROFILE_COUNT]; /* of the frame being measured */
+  uint64_t frameTicks;
+  uint64_t frameNs;
+
+  float history[GB_PROFILE_COUNT + 1][GB_PROFILE_HISTORY];
+  int head; /* oldest entry, next to be overwritten */
+  int frames;
+} Profile;
+
+static _Thread_local Profile profile;
+
+static uint64_t nanoseconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void gbProfileBegin(GBProfileZone zone) {
+  Profile *p = &profile;
+  if (p->depth == MAX_DEPTH) {
+    p->overflow++;
+    return;
+  }
+  uint64_t now = TICKS();
+  if (p->depth > 0)
+    p->ticks[p->stack[p->depth - 1]] += now - p->start[p->depth - 1];
+  p->stack[p->depth] = zone;
+  p->start[p->depth] = now;
+  p->depth++;
+}
+
+void gbProfileEnd(void) {
+  Profile *p = &profile;
+  if (p->overflow > 0) {
+    p->overflow--;
+    return;
+  }
+  uint64_t now = TICKS();
+  if (p->depth == 0)
+    return;
+  p->depth--;
+  p->ticks[p->stack[p->depth]] += now - p->start[p->depth];
+  if (p->depth > 0)
+    p->start[p->depth - 1] = now;
+}
+
+void gbProfileFrame(void) {
+  Profile *p = &profile;
+  uint64_t ticks = TICKS();
+  uint64_t ns = nanoseconds();
+
+  /* The tick rate is recalibrated against the wall clock every frame */
+  if (p->frameNs != 0 && ns > p->frameNs) {
+    double us = (ns - p->frameNs) / 1e3;
+    double usPerTick = us / (double)(ticks - p->frameTicks);
+    for (int i = 0; i < GB_PROFILE_COUNT; i++)
+      p->history[i][p->head] = (float)(p->ticks[i] * usPerTick);
+    p->history[GB_PROFILE_COUNT][p->head] = (float)us;
+    p->head = (p->head + 1) % GB_PROFILE_HISTORY;
+    if (p->frames < GB_PROFILE_HISTORY)
+      p->frames++;
+  }
+
+  for (int i = 0; i < GB_PROFILE_COUNT; i++)
+    p->ticks[i] = 0;
+  for (int i = 0; i < p->depth; i++)
+    p->start[i] = ticks;
+  p->frameTicks = ticks;
+  p->frameNs = ns;
+}
+
+const float *gbProfileHistory(int zone, int *offset) {
+  *offset = profile.head;
+  return profile.history[zone];
+}
+
+GBProfileStats gbProfileGetStats(int zone) {
+  const Profile *p = &profile;
+  GBProfileStats stats = {0, 0, 0};
+  for (int i = 0; i < p->frames; i++) {
+    int at = (p->head - 1 - i + GB_PROFILE_HISTORY) % GB_PROFILE_HISTORY;
+    float v = p->history[zone][at];
+    if (i == 0 || v < stats.min)
+      stats.min = v;
+    if (v > stats.max)
+      stats.max = v;
+    stats.avg += v;
+  }
+  if (p->frames > 0)
+    stats.avg /= p->frames;
+  return stats;
+}
+
+static void writeCsv(FILE *f) {
+  const Profile *p = &profile;
+  fprintf(f, "frame");
+  for (int i = 0; i < GB_PROFILE_COUNT; i++)
+    fprintf(f, ",%s_us", gbProfileZoneNames[i]);
+  fprintf(f, ",total_us\n");
+
+  for (int i = 0; i < p->frames; i++) {
+    int at = (p->head - p->frames + i + GB_PROFILE_HISTORY);
+    at %= GB_PROFILE_HISTORY;
+    fprintf(f, "%d", i);
+    for (int z = 0; z <= GB_PROFILE_COUNT; z++)
+      fprintf(f, ",%.2f", p->history[z][at]);
+    fprintf(f, "\n");
+  }
+}
+
+int gbProfileDumpCsv(const char *path) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    gbSetError("<<gbProfileDumpCsv>> cannot open %s", path);
+    return 1;
+  }
+  writeCsv(f);
+  fclose(f);
+  return 0;
+}
+
+char *gbProfileSerializeCsv(size_t *size) {
+  char *csv = NULL;
+  FILE *f = open_memstream(&csv, size);
+  if (f == NULL) {
+    gbSetError("<<gbProfileSerializeCsv>> out of memory");
+    return NULL;
+  }
+  writeCsv(f);
+  if (fclose(f) != 0) {
+    gbSetError("<<gbProfileSerializeCsv>> out of memory");
+    free(csv);
+    return NULL;
+  }
+  return csv;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Per-subsystem host time profiler, compiled in with -DGB_PROFILE=ON. Zones
+ * nest and are exclusive: time spent in a zone opened inside another is only
+ * charged to the inner one. Timings are per thread; gbProfileFrame closes a
+ * frame on the calling thread and appends it to a history of the last
+ * GB_PROFILE_HISTORY frames. With the option off every macro expands to
+ * nothing.
+ */
+
+#define GB_PROFILE_HISTORY 240
+
+typedef enum {
+  GB_PROFILE_CPU,
+  GB_PROFILE_MEM, /* gbWrite: mapper and I/O register handlers */
+  GB_PROFILE_TIMER,
+  GB_PROFILE_PPU,
+  GB_PROFILE_APU,
+  GB_PROFILE_UPLOAD, /* framebuffer to texture */
+  GB_PROFILE_IMGUI,
+  GB_PROFILE_SWAP,
+  GB_PROFILE_COUNT
+} GBProfileZone;
+
+extern const char *const gbProfileZoneNames[GB_PROFILE_COUNT];
+
+typedef struct {
+  float min, avg, max; /* microseconds per frame over the history */
+} GBProfileStats;
+
+#ifdef GB_PROFILE
+
+void gbProfileBegin(GBProfileZone zone);
+void gbProfileEnd(void);
+void gbProfileFrame(void);
+
+/*
+ * Microseconds per frame, oldest first starting at *offset, in the layout
+ * igPlotLines expects. GB_PROFILE_COUNT gives whole frame times.
+ */
+const float *gbProfileHistory(int zone, int *offset);
+GBProfileStats gbProfileGetStats(int zone);
+
+/* One row per frame in the history, one column per zone */
+int gbProfileDumpCsv(const char *path);
+/* The same CSV in a malloc'd buffer, e.g. for gbWriterWrite */
+char *gbProfileSerializeCsv(size_t *size);
+
+#define GB_PROFILE_BEGIN(zone) gbProfileBegin(zone)
+#define GB_PROFILE_END() gbProfileEnd()
+#define GB_PROFILE_FRAME() gbProfileFrame()
+
+#else
+
+#define GB_PROFILE_BEGIN(zone) ((void)0)
+#define GB_PROFILE_END() ((void)0)
+#define GB_PROFILE_FRAME() ((void)0)
+
+#endif
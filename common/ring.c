@@ -0,0 +1,86 @@
+#include "ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+
+GBRing *gbRingNew(size_t capacity) {
+  size_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  GBRing *ring = malloc(sizeof(GBRing));
+  unsigned char *data = malloc(size);
+  if (ring == NULL || data == NULL) {
+    gbSetError("<<gbRingNew>> out of memory");
+    free(ring);
+    free(data);
+    return NULL;
+  }
+  ring->data = data;
+  ring->mask = size - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  return ring;
+}
+
+void gbRingFree(GBRing *ring) {
+  free(ring->data);
+  free(ring);
+}
+
+/* Copies size bytes between a linear buffer and the ring at position */
+static void copyIn(GBRing *ring, size_t position, const void *data,
+                   size_t size) {
+  size_t offset = position & ring->mask;
+  size_t first = ring->mask + 1 - offset;
+  if (first > size)
+    first = size;
+  memcpy(ring->data + offset, data, first);
+  memcpy(ring->data, (const unsigned char *)data + first, size - first);
+}
+
+static void copyOut(const GBRing *ring, size_t position, void *data,
+                    size_t size) {
+  size_t offset = position & ring->mask;
+  size_t first = ring->mask + 1 - offset;
+  if (first > size)
+    first = size;
+  memcpy(data, ring->data + offset, first);
+  memcpy((unsigned char *)data + first, ring->data, size - first);
+}
+
+size_t gbRingSpace(GBRing *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return ring->mask + 1 - (head - tail);
+}
+
+size_t gbRingWrite(GBRing *ring, const void *data, size_t size) {
+  size_t space = gbRingSpace(ring);
+  if (size > space)
+    size = space;
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  copyIn(ring, head, data, size);
+  /* publishes the bytes above to the consumer */
+  atomic_store_explicit(&ring->head, head + size, memory_order_release);
+  return size;
+}
+
+size_t gbRingAvailable(GBRing *ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return head - tail;
+}
+
+size_t gbRingRead(GBRing *ring, void *data, size_t size) {
+  size_t available = gbRingAvailable(ring);
+  if (size > available)
+    size = available;
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  copyOut(ring, tail, data, size);
+  /* hands the space back to the producer only once the copy is done */
+  atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+  return size;
+}
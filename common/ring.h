@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Lock-free byte ring for exactly one producer thread and one consumer
+ * thread, e.g. the emulation loop feeding an audio callback. Each side only
+ * stores its own index and reads the other's with acquire ordering, so
+ * neither ever blocks or takes a lock. Capacity is rounded up to a power of
+ * two.
+ */
+
+typedef struct {
+  unsigned char *data;
+  size_t mask;
+  atomic_size_t head; /* bytes written so far, producer only */
+  atomic_size_t tail; /* bytes read so far, consumer only */
+} GBRing;
+
+GBRing *gbRingNew(size_t capacity);
+void gbRingFree(GBRing *ring);
+
+/* Producer side, returns how much of data fit */
+size_t gbRingWrite(GBRing *ring, const void *data, size_t size);
+size_t gbRingSpace(GBRing *ring);
+
+/* Consumer side, returns how much was copied into data */
+size_t gbRingRead(GBRing *ring, void *data, size_t size);
+size_t gbRingAvailable(GBRing *ring);
@@ -0,0 +1,213 @@
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "error.h"
+
+typedef struct {
+  const char *name;
+  uint64_t ns;
+  char phase;
+} Event;
+
+/*
+ * Buffers are only created once a thread traces inside a capture, and are
+ * handed back when it exits so short-lived workers reuse them instead of
+ * growing the list. The owner publishes generation before count, so a reader
+ * that acquires count sees the generation those events belong to.
+ */
+typedef struct Buffer {
+  struct Buffer *next; /* all buffers ever created, newest first */
+  int tid;
+  atomic_bool owned;
+  _Atomic(const char *) threadName;
+  atomic_uint generation; /* capture the events belong to */
+  atomic_size_t count;
+  Event events[GB_TRACE_EVENTS];
+} Buffer;
+
+static _Atomic(Buffer *) buffers;
+static atomic_int threads;
+static atomic_bool active;
+static atomic_uint generation;
+static uint32_t framesLeft; /* only touched by the gbTraceFrame thread */
+static bool armed;
+static uint64_t epoch;
+
+static _Thread_local Buffer *buffer;
+static _Thread_local const char *threadName;
+static pthread_key_t exitKey; /* runs release when a tracing thread exits */
+static pthread_once_t exitKeyOnce = PTHREAD_ONCE_INIT;
+
+static uint64_t nanoseconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void release(void *b) { atomic_store(&((Buffer *)b)->owned, false); }
+
+static void createExitKey(void) { pthread_key_create(&exitKey, release); }
+
+static Buffer *claim(void) {
+  for (Buffer *b = atomic_load(&buffers); b != NULL; b = b->next) {
+    bool owned = false;
+    if (atomic_compare_exchange_strong(&b->owned, &owned, true))
+      return b;
+  }
+
+  Buffer *b = calloc(1, sizeof(Buffer));
+  if (b == NULL)
+    return NULL;
+  b->tid = atomic_fetch_add(&threads, 1) + 1;
+  atomic_init(&b->owned, true);
+  b->next = atomic_load(&buffers);
+  while (!atomic_compare_exchange_weak(&buffers, &b->next, b))
+    ;
+  return b;
+}
+
+static Buffer *threadBuffer(void) {
+  if (buffer != NULL)
+    return buffer;
+
+  pthread_once(&exitKeyOnce, createExitKey);
+  Buffer *b = claim();
+  if (b == NULL)
+    return NULL;
+  atomic_store(&b->threadName, threadName);
+  pthread_setspecific(exitKey, b);
+  buffer = b;
+  return b;
+}
+
+void gbTraceStart(uint32_t frames) {
+  framesLeft = frames;
+  armed = frames > 0;
+}
+
+bool gbTraceFrame(void) {
+  if (armed) {
+    armed = false;
+    epoch = nanoseconds();
+    atomic_fetch_add(&generation, 1);
+    atomic_store(&active, true);
+    return false;
+  }
+  if (!atomic_load_explicit(&active, memory_order_relaxed))
+    return false;
+  if (--framesLeft != 0)
+    return false;
+  atomic_store(&active, false);
+  return true;
+}
+
+bool gbTraceStop(void) {
+  armed = false;
+  return atomic_exchange(&active, false);
+}
+
+bool gbTraceActive(void) {
+  return atomic_load_explicit(&active, memory_order_relaxed);
+}
+
+void gbTraceSetThreadName(const char *name) {
+  threadName = name;
+  if (buffer != NULL)
+    atomic_store(&buffer->threadName, name);
+}
+
+void gbTraceEvent(const char *name, char phase) {
+  Buffer *b = threadBuffer();
+  if (b == NULL)
+    return;
+
+  /* Only the owning thread writes a buffer, so a new capture resets it here */
+  uint32_t current = atomic_load(&generation);
+  if (atomic_load_explicit(&b->generation, memory_order_relaxed) != current) {
+    atomic_store_explicit(&b->generation, current, memory_order_relaxed);
+    atomic_store_explicit(&b->count, 0, memory_order_release);
+  }
+
+  size_t count = atomic_load_explicit(&b->count, memory_order_relaxed);
+  if (count == GB_TRACE_EVENTS)
+    return;
+  b->events[count] = (Event){name, nanoseconds(), phase};
+  atomic_store_explicit(&b->count, count + 1, memory_order_release);
+}
+
+static void writeJson(FILE *f) {
+  uint32_t current = atomic_load(&generation);
+  bool first = true;
+  fprintf(f, "{\"traceEvents\": [\n");
+  for (Buffer *b = atomic_load(&buffers); b != NULL; b = b->next) {
+    const char *name = atomic_load(&b->threadName);
+    if (name != NULL) {
+      fprintf(f,
+              "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+              "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+              first ? "" : ",\n", b->tid, name);
+      first = false;
+    }
+    size_t count = atomic_load_explicit(&b->count, memory_order_acquire);
+    if (atomic_load_explicit(&b->generation, memory_order_relaxed) != current)
+      continue;
+
+    for (size_t i = 0; i < count; i++) {
+      const Event *e = &b->events[i];
+      fprintf(f,
+              "%s{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, "
+              "\"pid\": 1, \"tid\": %d}",
+              first ? "" : ",\n", e->name, e->phase,
+              (double)(e->ns - epoch) / 1e3, b->tid);
+      first = false;
+    }
+  }
+  fprintf(f, "\n]}\n");
+}
+
+void gbTraceShutdown(void) {
+  Buffer *b = atomic_exchange(&buffers, NULL);
+  while (b != NULL) {
+    Buffer *next = b->next;
+    free(b);
+    b = next;
+  }
+  if (buffer != NULL)
+    pthread_setspecific(exitKey, NULL);
+  buffer = NULL;
+}
+
+int gbTraceWrite(const char *path) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    gbSetError("<<gbTraceWrite>> cannot open %s", path);
+    return 1;
+  }
+  writeJson(f);
+  if (fclose(f) != 0) {
+    gbSetError("<<gbTraceWrite>> cannot write %s", path);
+    return 1;
+  }
+  return 0;
+}
+
+char *gbTraceSerialize(size_t *size) {
+  char *json = NULL;
+  FILE *f = open_memstream(&json, size);
+  if (f == NULL) {
+    gbSetError("<<gbTraceSerialize>> out of memory");
+    return NULL;
+  }
+  writeJson(f);
+  if (fclose(f) != 0) {
+    gbSetError("<<gbTraceSerialize>> out of memory");
+    free(json);
+    return NULL;
+  }
+  return json;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Timeline tracing in the Chrome trace event format, which Perfetto and
+ * chrome://tracing open offline. gbTraceStart arms a capture of the next
+ * `frames` calls to gbTraceFrame; while it runs every thread appends begin/end
+ * events to a buffer of its own without locking. Outside a capture each trace
+ * point costs one load and a branch.
+ */
+
+#define GB_TRACE_EVENTS 0x10000 /* per thread and capture */
+
+void gbTraceStart(uint32_t frames);
+/* Call once per host frame, returns true when a capture just completed */
+bool gbTraceFrame(void);
+bool gbTraceActive(void);
+/* Ends a capture early, returns true if one was running */
+bool gbTraceStop(void);
+
+/* name must outlive the capture, in practice a string literal */
+void gbTraceEvent(const char *name, char phase);
+void gbTraceSetThreadName(const char *name);
+/* Frees every thread's buffer, call at exit once no other thread traces */
+void gbTraceShutdown(void);
+
+/* Writes the last completed capture */
+int gbTraceWrite(const char *path);
+/* The same JSON in a malloc'd buffer, e.g. for gbWriterWrite */
+char *gbTraceSerialize(size_t *size);
+
+#define GB_TRACE_BEGIN(name)                                                   \
+  do {                                                                         \
+    if (gbTraceActive())                                                       \
+      gbTraceEvent(name, 'B');                                                 \
+  } while (0)
+
+#define GB_TRACE_END(name)                                                     \
+  do {                                                                         \
+    if (gbTraceActive())                                                       \
+      gbTraceEvent(name, 'E');                                                 \
+  } while (0)
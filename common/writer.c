@@ -0,0 +1,156 @@
+#include "writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "trace.h"
+
+static int writeFile(const char *path, const void *data, size_t size) {
+  char temp[GB_WRITER_PATH + 8];
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+  int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return errno;
+  const char *p = data;
+  for (size_t done = 0; done < size;) {
+    ssize_t n = pwrite(fd, p + done, size - done, (off_t)done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      int error = errno;
+      close(fd);
+      unlink(temp);
+      return error;
+    }
+    done += (size_t)n;
+  }
+  /* the data has to be on disk before the rename makes it the file */
+  int error = fsync(fd) != 0 ? errno : 0;
+  if (close(fd) != 0 && error == 0)
+    error = errno;
+  if (error == 0 && rename(temp, path) != 0)
+    error = errno;
+  if (error != 0) {
+    unlink(temp);
+    return error;
+  }
+  return 0;
+}
+
+static void *work(void *arg) {
+  GBWriter *writer = arg;
+  gbTraceSetThreadName("writer");
+
+  pthread_mutex_lock(&writer->lock);
+  for (;;) {
+    while (writer->finished == writer->submitted && !writer->quit)
+      pthread_cond_wait(&writer->wake, &writer->lock);
+    if (writer->finished == writer->submitted)
+      break;
+
+    /* The slot is ours until finished moves past it */
+    GBWriterJob *job = &writer->jobs[writer->finished % GB_WRITER_JOBS];
+    pthread_mutex_unlock(&writer->lock);
+
+    GB_TRACE_BEGIN("write file");
+    if (job->sync) {
+      job->error = msync(job->data, job->size, MS_SYNC) != 0 ? errno : 0;
+    } else {
+      job->error = writeFile(job->path, job->data, job->size);
+      free(job->data);
+    }
+    job->data = NULL;
+    GB_TRACE_END("write file");
+
+    pthread_mutex_lock(&writer->lock);
+    writer->finished++;
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return NULL;
+}
+
+GBWriter *gbWriterNew(void) {
+  GBWriter *writer = malloc(sizeof(GBWriter));
+  if (writer == NULL) {
+    gbSetError("<<gbWriterNew>> out of memory");
+    return NULL;
+  }
+  memset(writer, 0, sizeof(GBWriter));
+  pthread_mutex_init(&writer->lock, NULL);
+  pthread_cond_init(&writer->wake, NULL);
+  if (pthread_create(&writer->thread, NULL, work, writer) != 0) {
+    gbSetError("<<gbWriterNew>> cannot start the worker thread");
+    pthread_cond_destroy(&writer->wake);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+void gbWriterFree(GBWriter *writer) {
+  pthread_mutex_lock(&writer->lock);
+  writer->quit = true;
+  pthread_cond_signal(&writer->wake);
+  pthread_mutex_unlock(&writer->lock);
+  pthread_join(writer->thread, NULL);
+
+  pthread_cond_destroy(&writer->wake);
+  pthread_mutex_destroy(&writer->lock);
+  free(writer);
+}
+
+static int submit(GBWriter *writer, const char *path, void *data, size_t size,
+                  bool sync) {
+  const char *name = sync ? "gbWriterSync" : "gbWriterWrite";
+  if (strlen(path) >= GB_WRITER_PATH) {
+    gbSetError("<<%s>> path too long: %s", name, path);
+    return 1;
+  }
+
+  pthread_mutex_lock(&writer->lock);
+  if (writer->submitted - writer->polled == GB_WRITER_JOBS) {
+    pthread_mutex_unlock(&writer->lock);
+    gbSetError("<<%s>> queue full, %s skipped", name, path);
+    return 1;
+  }
+  GBWriterJob *job = &writer->jobs[writer->submitted % GB_WRITER_JOBS];
+  strcpy(job->path, path);
+  job->data = data;
+  job->size = size;
+  job->sync = sync;
+  job->error = 0;
+  writer->submitted++;
+  pthread_cond_signal(&writer->wake);
+  pthread_mutex_unlock(&writer->lock);
+  return 0;
+}
+
+int gbWriterWrite(GBWriter *writer, const char *path, void *data,
+                  size_t size) {
+  return submit(writer, path, data, size, false);
+}
+
+int gbWriterSync(GBWriter *writer, const char *path, void *data, size_t size) {
+  return submit(writer, path, data, size, true);
+}
+
+bool gbWriterPoll(GBWriter *writer, GBWriterResult *result) {
+  pthread_mutex_lock(&writer->lock);
+  bool found = writer->polled < writer->finished;
+  if (found) {
+    const GBWriterJob *job = &writer->jobs[writer->polled % GB_WRITER_JOBS];
+    memcpy(result->path, job->path, sizeof(result->path));
+    result->error = job->error;
+    writer->polled++;
+  }
+  pthread_mutex_unlock(&writer->lock);
+  return found;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Background file writer, so the emulation and render threads never wait on
+ * the filesystem. gbWriterWrite hands a malloc'd buffer over to a worker
+ * thread, which writes it to a temporary file, renames that over path and
+ * frees the buffer: no copy is made and a crash mid-write leaves the old file
+ * intact. gbWriterSync has the worker msync a shared mapping instead. The
+ * queue is bounded; when it is full a submit fails without blocking and the
+ * buffer stays with the caller. Results come back through gbWriterPoll on the
+ * submitting thread.
+ */
+
+#define GB_WRITER_JOBS 16
+#define GB_WRITER_PATH 512
+
+typedef struct {
+  char path[GB_WRITER_PATH];
+  void *data;
+  size_t size;
+  bool sync; /* msync data instead of writing it out */
+  int error; /* errno of the failed step, 0 on success */
+} GBWriterJob;
+
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock; /* guards the counters, never held during I/O */
+  pthread_cond_t wake;
+  GBWriterJob jobs[GB_WRITER_JOBS]; /* indexed by counter % GB_WRITER_JOBS */
+  size_t submitted;
+  size_t finished;
+  size_t polled;
+  bool quit;
+} GBWriter;
+
+typedef struct {
+  char path[GB_WRITER_PATH];
+  int error;
+} GBWriterResult;
+
+GBWriter *gbWriterNew(void);
+/* Finishes the queued jobs first */
+void gbWriterFree(GBWriter *writer);
+
+/* Takes ownership of data (from malloc) unless it returns 1 */
+int gbWriterWrite(GBWriter *writer, const char *path, void *data, size_t size);
+/* path only labels the result; data must stay mapped until it is polled */
+int gbWriterSync(GBWriter *writer, const char *path, void *data, size_t size);
+
+/* Returns false once every finished job has been reported */
+bool gbWriterPoll(GBWriter *writer, GBWriterResult *result);
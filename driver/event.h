@@ -3,9 +3,28 @@
 typedef enum {
   GB_DRIVER_QUIT,
   GB_DRIVER_RESIZE,
+  GB_DRIVER_INPUT,
+  GB_DRIVER_HOTKEY,
   GB_DRIVER_NATIVE,
 } GBDriverEventType;
 
+typedef enum {
+  GB_HOTKEY_TRACE,      /* capture a timeline trace */
+  GB_HOTKEY_SAVE_STATE, /* write a save state next to the ROM */
+  GB_HOTKEY_SCREENSHOT, /* write the screen as a PPM */
+} GBHotkey;
+
+typedef enum {
+  GB_BUTTON_RIGHT = 1 << 0,
+  GB_BUTTON_LEFT = 1 << 1,
+  GB_BUTTON_UP = 1 << 2,
+  GB_BUTTON_DOWN = 1 << 3,
+  GB_BUTTON_A = 1 << 4,
+  GB_BUTTON_B = 1 << 5,
+  GB_BUTTON_SELECT = 1 << 6,
+  GB_BUTTON_START = 1 << 7,
+} GBButton;
+
 typedef struct {
   GBDriverEventType type;
   union {
@@ -13,6 +32,12 @@ typedef struct {
       int width;
       int height;
     };
+    struct {
+      unsigned char buttons; /* GBButton mask of the buttons held down */
+    };
+    struct {
+      GBHotkey hotkey;
+    };
     void *_nothing;
   };
 } GBDriverEvent;
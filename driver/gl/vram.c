@@ -0,0 +1,234 @@
+#include "vram.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emu/gb.h"
+
+#define LCDC_SPRITES_TALL 0x04
+#define LCDC_TILES_UNSIGNED 0x10
+
+#define OAM_PALETTE 0x10
+#define OAM_FLIP_X 0x20
+#define OAM_FLIP_Y 0x40
+
+/* rebuild the whole texture when more than this share of it changed */
+#define BULK_DIVISOR 4
+
+static GLuint newTexture(int width, int height) {
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+  return texture;
+}
+
+GBVramViewer *gbVramViewerNew(const byte shades[4]) {
+  GBVramViewer *viewer = malloc(sizeof(GBVramViewer));
+  if (viewer == NULL) {
+    gbSetError("<<gbVramViewerNew>> out of memory");
+    return NULL;
+  }
+  memset(viewer, 0, sizeof(GBVramViewer));
+  memcpy(viewer->shades, shades, sizeof(viewer->shades));
+  viewer->tiles = newTexture(GB_VRAM_TILES_WIDTH, GB_VRAM_TILES_HEIGHT);
+  for (int i = 0; i < 2; i++)
+    viewer->maps[i] = newTexture(GB_VRAM_MAP_SIZE, GB_VRAM_MAP_SIZE);
+  viewer->sprites = newTexture(GB_VRAM_SPRITES_WIDTH, GB_VRAM_SPRITES_HEIGHT);
+  return viewer;
+}
+
+void gbVramViewerFree(GBVramViewer *viewer) {
+  glDeleteTextures(1, &viewer->tiles);
+  glDeleteTextures(2, viewer->maps);
+  glDeleteTextures(1, &viewer->sprites);
+  free(viewer);
+}
+
+/*
+ * Decodes an 8x8 tile through palette into out, stride bytes per row.
+ * Color 0 is left transparent when transparent is set, as sprites draw it.
+ */
+static void decodeTile(const GBVramViewer *viewer, const byte *tile,
+                       byte palette, byte flags, bool transparent, byte *out,
+                       size_t stride) {
+  for (int y = 0; y < 8; y++) {
+    int row = flags & OAM_FLIP_Y ? 7 - y : y;
+    byte lo = tile[row * 2];
+    byte hi = tile[row * 2 + 1];
+    byte *px = out + (size_t)y * stride;
+    for (int x = 0; x < 8; x++) {
+      int bit = flags & OAM_FLIP_X ? x : 7 - x;
+      int color = ((hi >> bit) & 1) << 1 | ((lo >> bit) & 1);
+      byte v = viewer->shades[(palette >> (color * 2)) & 3];
+      px[0] = px[1] = px[2] = v;
+      px[3] = transparent && color == 0 ? 0 : 0xFF;
+      px += 4;
+    }
+  }
+}
+
+static void upload(GBVramViewer *viewer, GLuint texture, int x, int y,
+                   int width, int height, const byte *rgba) {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA,
+                  GL_UNSIGNED_BYTE, rgba);
+  viewer->uploads++;
+}
+
+/* Dirty cells of a texture, either uploaded one by one or all at once */
+typedef struct {
+  GLuint texture;
+  int width; /* in pixels */
+  int cellHeight;
+  int count; /* cells */
+  bool bulk;
+} Sheet;
+
+static byte *cellPixels(GBVramViewer *viewer, const Sheet *sheet, int cell,
+                        size_t *stride) {
+  int columns = sheet->width / 8;
+  if (!sheet->bulk) {
+    *stride = 8 * 4;
+    return viewer->rgba;
+  }
+  *stride = (size_t)sheet->width * 4;
+  return viewer->rgba +
+         ((size_t)(cell / columns) * sheet->cellHeight * sheet->width +
+          (size_t)(cell % columns) * 8) *
+             4;
+}
+
+static void finishCell(GBVramViewer *viewer, const Sheet *sheet, int cell) {
+  int columns = sheet->width / 8;
+  if (!sheet->bulk)
+    upload(viewer, sheet->texture, cell % columns * 8,
+           cell / columns * sheet->cellHeight, 8, sheet->cellHeight,
+           viewer->rgba);
+}
+
+static void finishSheet(GBVramViewer *viewer, const Sheet *sheet) {
+  if (sheet->bulk)
+    upload(viewer, sheet->texture, 0, 0, sheet->width,
+           sheet->count / (sheet->width / 8) * sheet->cellHeight,
+           viewer->rgba);
+}
+
+static int tileIndex(byte lcdc, byte entry) {
+  return lcdc & LCDC_TILES_UNSIGNED ? entry : 256 + (signed char)entry;
+}
+
+static void updateTiles(GBVramViewer *viewer, const byte *vram, int dirty,
+                        byte bgp) {
+  Sheet sheet = {viewer->tiles, GB_VRAM_TILES_WIDTH, 8, GB_VRAM_TILES,
+                 dirty > GB_VRAM_TILES / BULK_DIVISOR};
+  for (int t = 0; t < GB_VRAM_TILES; t++) {
+    if (!viewer->tileDirty[t] && !sheet.bulk)
+      continue;
+    size_t stride;
+    byte *out = cellPixels(viewer, &sheet, t, &stride);
+    decodeTile(viewer, vram + t * 16, bgp, 0, false, out, stride);
+    finishCell(viewer, &sheet, t);
+  }
+  finishSheet(viewer, &sheet);
+}
+
+static void updateMap(GBVramViewer *viewer, const byte *bus, int map,
+                      bool all) {
+  const byte *vram = bus + 0x8000;
+  const byte *entries = vram + 0x1800 + map * 0x400;
+  const byte *cached = viewer->vram + 0x1800 + map * 0x400;
+  byte lcdc = bus[GB_IO_LCDC];
+  byte bgp = bus[GB_IO_BGP];
+
+  bool dirty[32 * 32];
+  int count = 0;
+  for (int c = 0; c < 32 * 32; c++) {
+    dirty[c] = all || entries[c] != cached[c] ||
+               viewer->tileDirty[tileIndex(lcdc, entries[c])];
+    count += dirty[c];
+  }
+  if (count == 0)
+    return;
+
+  Sheet sheet = {viewer->maps[map], GB_VRAM_MAP_SIZE, 8, 32 * 32,
+                 count > 32 * 32 / BULK_DIVISOR};
+  for (int c = 0; c < 32 * 32; c++) {
+    if (!dirty[c] && !sheet.bulk)
+      continue;
+    size_t stride;
+    byte *out = cellPixels(viewer, &sheet, c, &stride);
+    decodeTile(viewer, vram + tileIndex(lcdc, entries[c]) * 16, bgp, 0, false,
+               out, stride);
+    finishCell(viewer, &sheet, c);
+  }
+  finishSheet(viewer, &sheet);
+}
+
+static void updateSprites(GBVramViewer *viewer, const byte *bus, bool all) {
+  const byte *vram = bus + 0x8000;
+  const byte *oam = bus + 0xFE00;
+  bool tall = bus[GB_IO_LCDC] & LCDC_SPRITES_TALL;
+
+  Sheet sheet = {viewer->sprites, GB_VRAM_SPRITES_WIDTH, 16, 40, all};
+  for (int s = 0; s < 40; s++) {
+    const byte *entry = oam + s * 4;
+    byte tile = tall ? entry[2] & 0xFE : entry[2];
+    if (!all && memcmp(entry, viewer->oam + s * 4, 4) == 0 &&
+        !viewer->tileDirty[tile] && !(tall && viewer->tileDirty[tile + 1]))
+      continue;
+
+    byte palette = bus[entry[3] & OAM_PALETTE ? GB_IO_OBP1 : GB_IO_OBP0];
+    size_t stride;
+    byte *out = cellPixels(viewer, &sheet, s, &stride);
+    /* keeps the lower half clear for 8x8 sprites */
+    for (int y = 0; y < 16; y++)
+      memset(out + y * stride, 0, 8 * 4);
+    /* a vertically flipped tall sprite starts with its second tile */
+    bool swap = tall && (entry[3] & OAM_FLIP_Y);
+    decodeTile(viewer, vram + (tile + swap) * 16, palette, entry[3], true,
+               out, stride);
+    if (tall)
+      decodeTile(viewer, vram + (tile + !swap) * 16, palette, entry[3], true,
+                 out + 8 * stride, stride);
+    finishCell(viewer, &sheet, s);
+  }
+  finishSheet(viewer, &sheet);
+}
+
+void gbVramViewerUpdate(GBVramViewer *viewer, const byte *bus) {
+  const byte *vram = bus + 0x8000;
+  viewer->uploads = 0;
+
+  byte lcdc = bus[GB_IO_LCDC];
+  byte bgp = bus[GB_IO_BGP];
+  byte obp[2] = {bus[GB_IO_OBP0], bus[GB_IO_OBP1]};
+  bool allTiles = !viewer->primed || bgp != viewer->bgp;
+  bool allMaps = allTiles || (lcdc ^ viewer->lcdc) & LCDC_TILES_UNSIGNED;
+  bool allSprites = !viewer->primed || obp[0] != viewer->obp[0] ||
+                    obp[1] != viewer->obp[1] ||
+                    (lcdc ^ viewer->lcdc) & LCDC_SPRITES_TALL;
+
+  int dirty = 0;
+  for (int t = 0; t < GB_VRAM_TILES; t++) {
+    viewer->tileDirty[t] =
+        allTiles || memcmp(vram + t * 16, viewer->vram + t * 16, 16) != 0;
+    dirty += viewer->tileDirty[t];
+  }
+
+  if (dirty != 0)
+    updateTiles(viewer, vram, dirty, bgp);
+  for (int map = 0; map < 2; map++)
+    updateMap(viewer, bus, map, allMaps);
+  updateSprites(viewer, bus, allSprites);
+
+  memcpy(viewer->vram, vram, sizeof(viewer->vram));
+  memcpy(viewer->oam, bus + 0xFE00, sizeof(viewer->oam));
+  viewer->lcdc = lcdc;
+  viewer->bgp = bgp;
+  memcpy(viewer->obp, obp, sizeof(obp));
+  viewer->primed = true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "impl.h"
+
+#include "common.h"
+
+/*
+ * Debugger textures of VRAM: the 384 tiles, both background maps and the 40
+ * OAM sprites. Each update diffs a 64K bus image against the bytes the
+ * textures were last built from and only re-decodes and uploads the 8x8 cells
+ * that depend on changed tiles, map entries, OAM entries or palettes. When
+ * most of a texture changed it is rebuilt and uploaded in one call instead.
+ */
+
+#define GB_VRAM_TILES 384
+
+#define GB_VRAM_TILES_WIDTH (16 * 8)
+#define GB_VRAM_TILES_HEIGHT (GB_VRAM_TILES / 16 * 8)
+#define GB_VRAM_MAP_SIZE 256
+#define GB_VRAM_SPRITES_WIDTH (8 * 8)
+#define GB_VRAM_SPRITES_HEIGHT (5 * 16)
+
+typedef struct {
+  GLuint tiles;
+  GLuint maps[2]; /* 0x9800 and 0x9C00 */
+  GLuint sprites; /* 8x16 cells, the lower half empty with 8x8 sprites */
+  int uploads;    /* glTexSubImage2D calls made by the last update */
+
+  byte shades[4];
+  bool primed;       /* the textures hold something */
+  byte vram[0x2000]; /* bytes the textures were built from */
+  byte oam[0xA0];
+  byte lcdc, bgp, obp[2];
+
+  bool tileDirty[GB_VRAM_TILES];
+  byte rgba[GB_VRAM_MAP_SIZE * GB_VRAM_MAP_SIZE * 4]; /* whole texture */
+} GBVramViewer;
+
+/* shades maps a color 0-3 to a gray level, needs a current GL context */
+GBVramViewer *gbVramViewerNew(const byte shades[4]);
+void gbVramViewerFree(GBVramViewer *viewer);
+
+void gbVramViewerUpdate(GBVramViewer *viewer, const byte *bus);
@@ -0,0 +1,259 @@
+#include "driver.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int gbDriverInit(void) { return 0; }
+
+void gbDriverQuit(void) {}
+
+uint32_t gbDriverGetTicks(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+GBDriver *gbDriverNew(int width, int height) {
+  GBDriver *driver = malloc(sizeof(GBDriver));
+  if (driver == NULL) {
+    gbSetError("<<gbDriverNew>> out of memory");
+    return NULL;
+  }
+  memset(driver, 0, sizeof(GBDriver));
+
+  driver->framebuffer = calloc((size_t)width * height, GB_DRIVER_CHANNELS);
+  if (driver->framebuffer == NULL) {
+    gbSetError("<<gbDriverNew>> cannot allocate %dx%d framebuffer", width,
+               height);
+    free(driver);
+    return NULL;
+  }
+
+  driver->width = width;
+  driver->height = height;
+  driver->dumpFormat = GB_DUMP_NONE;
+  return driver;
+}
+
+void gbDriverFree(GBDriver *driver) {
+  if (driver->dumpFile != NULL)
+    fclose(driver->dumpFile);
+  free(driver->dumpPath);
+  free(driver->script);
+  free(driver->framebuffer);
+  free(driver);
+}
+
+static int dumpPPM(GBDriver *driver) {
+  char path[1024];
+  /* the pattern was checked by gbDriverSetDump to take one unsigned */
+  snprintf(path, sizeof(path), driver->dumpPath, (unsigned)driver->frame);
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    gbSetError("<<gbDriverDraw>> cannot open %s", path);
+    return 1;
+  }
+
+  fprintf(f, "P6\n%d %d\n255\n", driver->width, driver->height);
+  const byte *px = driver->framebuffer;
+  for (int i = 0; i < driver->width * driver->height; i++) {
+    /* BGRA -> RGB */
+    byte rgb[3] = {px[2], px[1], px[0]};
+    fwrite(rgb, 1, sizeof(rgb), f);
+    px += GB_DRIVER_CHANNELS;
+  }
+  fclose(f);
+  return 0;
+}
+
+int gbDriverDraw(GBDriver *driver) {
+  int err = 0;
+  if (driver->dumpFormat == GB_DUMP_RAW && driver->dumpFile != NULL)
+    fwrite(driver->framebuffer, GB_DRIVER_CHANNELS,
+           (size_t)driver->width * driver->height, driver->dumpFile);
+  else if (driver->dumpFormat == GB_DUMP_PPM)
+    err = dumpPPM(driver);
+
+  driver->frame++;
+  return err;
+}
+
+int gbDriverPollEvent(GBDriver *driver, GBDriverEvent *event) {
+  if (driver->scriptCursor < driver->scriptLength) {
+    GBDriverScriptEntry *entry = &driver->script[driver->scriptCursor];
+    if (entry->frame <= driver->frame) {
+      *event = entry->event;
+      driver->scriptCursor++;
+      return true;
+    }
+  }
+  if (driver->maxFrames != 0 && driver->frame >= driver->maxFrames &&
+      !driver->quitRaised) {
+    event->type = GB_DRIVER_QUIT;
+    driver->quitRaised = true;
+    return true;
+  }
+  return 0;
+}
+
+static const struct {
+  const char *name;
+  GBButton button;
+} ButtonNames[] = {
+    {"RIGHT", GB_BUTTON_RIGHT}, {"LEFT", GB_BUTTON_LEFT},
+    {"UP", GB_BUTTON_UP},       {"DOWN", GB_BUTTON_DOWN},
+    {"A", GB_BUTTON_A},         {"B", GB_BUTTON_B},
+    {"SELECT", GB_BUTTON_SELECT}, {"START", GB_BUTTON_START},
+};
+
+static int parseButtons(char *str, unsigned char *buttons) {
+  *buttons = 0;
+  if (strcmp(str, "-") == 0)
+    return 0;
+
+  for (char *tok = strtok(str, "+"); tok != NULL; tok = strtok(NULL, "+")) {
+    size_t i;
+    for (i = 0; i < sizeof(ButtonNames) / sizeof(ButtonNames[0]); i++)
+      if (strcmp(tok, ButtonNames[i].name) == 0)
+        break;
+    if (i == sizeof(ButtonNames) / sizeof(ButtonNames[0]))
+      return 1;
+    *buttons |= ButtonNames[i].button;
+  }
+  return 0;
+}
+
+/*
+ * Script lines are "<frame> <buttons>", where buttons is a '+' separated list
+ * of RIGHT LEFT UP DOWN A B SELECT START, '-' to release everything, or QUIT.
+ * Entries must be sorted by frame; '#' starts a comment.
+ */
+int gbDriverLoadScript(GBDriver *driver, const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    gbSetError("<<gbDriverLoadScript>> cannot open %s", path);
+    return 1;
+  }
+
+  size_t capacity = 16;
+  GBDriverScriptEntry *script = malloc(capacity * sizeof(*script));
+  size_t length = 0;
+  if (script == NULL) {
+    gbSetError("<<gbDriverLoadScript>> out of memory");
+    fclose(f);
+    return 1;
+  }
+
+  char line[256];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    char *comment = strchr(line, '#');
+    if (comment != NULL)
+      *comment = '\0';
+
+    unsigned int frame;
+    char action[128];
+    int n = sscanf(line, "%u %127s", &frame, action);
+    if (n <= 0)
+      continue;
+
+    GBDriverScriptEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.frame = frame;
+    if (n == 2 && strcmp(action, "QUIT") == 0) {
+      entry.event.type = GB_DRIVER_QUIT;
+    } else if (n == 2 && parseButtons(action, &entry.event.buttons) == 0) {
+      entry.event.type = GB_DRIVER_INPUT;
+    } else {
+      gbSetError("<<gbDriverLoadScript>> %s:%d: invalid entry", path, lineno);
+      free(script);
+      fclose(f);
+      return 1;
+    }
+
+    if (length > 0 && script[length - 1].frame > frame) {
+      gbSetError("<<gbDriverLoadScript>> %s:%d: frames are not sorted", path,
+                 lineno);
+      free(script);
+      fclose(f);
+      return 1;
+    }
+
+    if (length == capacity) {
+      GBDriverScriptEntry *grown =
+          realloc(script, capacity * 2 * sizeof(*script));
+      if (grown == NULL) {
+        gbSetError("<<gbDriverLoadScript>> out of memory");
+        free(script);
+        fclose(f);
+        return 1;
+      }
+      script = grown;
+      capacity *= 2;
+    }
+    script[length++] = entry;
+  }
+  fclose(f);
+
+  free(driver->script);
+  driver->script = script;
+  driver->scriptLength = length;
+  driver->scriptCursor = 0;
+  return 0;
+}
+
+/* A PPM pattern must hold exactly one integer conversion for the frame
+ * number, anything else would make snprintf read arguments it never got */
+static bool validPattern(const char *pattern) {
+  int conversions = 0;
+  for (const char *p = pattern; *p != '\0'; p++) {
+    if (*p != '%')
+      continue;
+    if (*++p == '%')
+      continue;
+    p += strspn(p, "-+ #0");
+    p += strspn(p, "0123456789");
+    if (*p == '.') {
+      p++;
+      p += strspn(p, "0123456789");
+    }
+    if (*p == '\0' || strchr("diouxX", *p) == NULL)
+      return false;
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+int gbDriverSetDump(GBDriver *driver, GBDriverDumpFormat format,
+                    const char *path) {
+  if (driver->dumpFile != NULL) {
+    fclose(driver->dumpFile);
+    driver->dumpFile = NULL;
+  }
+  free(driver->dumpPath);
+  driver->dumpPath = NULL;
+  driver->dumpFormat = GB_DUMP_NONE;
+
+  if (format == GB_DUMP_NONE)
+    return 0;
+
+  if (format == GB_DUMP_PPM && !validPattern(path)) {
+    gbSetError("<<gbDriverSetDump>> %s needs exactly one integer conversion",
+               path);
+    return 1;
+  }
+  if (format == GB_DUMP_RAW) {
+    driver->dumpFile = fopen(path, "wb");
+    if (driver->dumpFile == NULL) {
+      gbSetError("<<gbDriverSetDump>> cannot open %s", path);
+      return 1;
+    }
+  }
+
+  driver->dumpPath = strdup(path);
+  driver->dumpFormat = format;
+  return 0;
+}
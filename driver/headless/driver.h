@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common.h"
+#include "event.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define GB_DRIVER_CHANNELS 4
+
+typedef enum {
+  GB_DUMP_NONE,
+  GB_DUMP_RAW, /* every frame appended to a single BGRA stream */
+  GB_DUMP_PPM, /* one binary PPM per frame, path is a printf pattern */
+} GBDriverDumpFormat;
+
+typedef struct {
+  uint32_t frame; /* frame on which the event is delivered */
+  GBDriverEvent event;
+} GBDriverScriptEntry;
+
+typedef struct {
+  int width;
+  int height;
+  byte *framebuffer; /* width * height BGRA pixels, same layout as the PBOs */
+  uint32_t frame;    /* number of frames presented with gbDriverDraw */
+  uint32_t maxFrames; /* GB_DRIVER_QUIT is raised once reached, 0 = never */
+  bool quitRaised;
+
+  GBDriverScriptEntry *script;
+  size_t scriptLength;
+  size_t scriptCursor;
+
+  GBDriverDumpFormat dumpFormat;
+  char *dumpPath;
+  FILE *dumpFile;
+} GBDriver;
+
+int gbDriverInit(void);
+void gbDriverQuit(void);
+
+uint32_t gbDriverGetTicks(void);
+
+GBDriver *gbDriverNew(int width, int height);
+void gbDriverFree(GBDriver *driver);
+
+int gbDriverDraw(GBDriver *driver);
+
+int gbDriverPollEvent(GBDriver *driver, GBDriverEvent *event);
+
+int gbDriverLoadScript(GBDriver *driver, const char *path);
+int gbDriverSetDump(GBDriver *driver, GBDriverDumpFormat format,
+                    const char *path);
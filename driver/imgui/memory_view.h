@@ -123,6 +123,9 @@
 #define CIMGUI_DEFINE_ENUMS_AND_STRUCTS
 #include <cimgui.h>
 
+#include "arena.h"
+#include "error.h"
+
 typedef enum {
   DataFormat_Bin = 0,
   DataFormat_Dec = 1,
@@ -165,6 +168,13 @@ typedef struct {
       const ImU8 *data,
       size_t off); //= 0      // optional handler to return Highlight property
                    //(to support non-contiguous highlighting).
+  ImU32 (*HighlightColorFn)(
+      const ImU8 *data,
+      size_t off); //= 0      // optional color of the bytes HighlightFn
+                   // selects, HighlightColor otherwise.
+
+  GBArena *Arena; // per-frame scratch, must be reset between frames
+  ImGuiListClipper *Clipper; // reused every frame, Begin() resets it
 
   // [Internal State]
   bool ContentsWidthChanged;
@@ -236,10 +246,8 @@ void DrawPreviewData(GBMemoryEditor *editor, size_t addr, const ImU8 *mem_data,
                      DataFormat data_format, char *out_buf,
                      size_t out_buf_size);
 
-Sizes *meditNewSize() {
-  Sizes *s = (Sizes *)malloc(sizeof(Sizes));
-  memset(s, 0, sizeof(Sizes));
-  return s;
+Sizes *meditNewSize(GBMemoryEditor *editor) {
+  return (Sizes *)gbArenaAlloc(editor->Arena, sizeof(Sizes));
 }
 
 void meditCalcSizes(GBMemoryEditor *editor, Sizes *s, size_t mem_size,
@@ -275,8 +283,12 @@ void meditCalcSizes(GBMemoryEditor *editor, Sizes *s, size_t mem_size,
                    style->WindowPadding.x * 2 + s->GlyphWidth;
 }
 
-GBMemoryEditor *meditMemoryEditorNew() {
+GBMemoryEditor *meditMemoryEditorNew(GBArena *arena) {
   GBMemoryEditor *editor = (GBMemoryEditor *)malloc(sizeof(GBMemoryEditor));
+  if (editor == NULL) {
+    gbSetError("<<meditMemoryEditorNew>> out of memory");
+    return NULL;
+  }
 
   // Settings
   editor->Open = true;
@@ -294,6 +306,9 @@ GBMemoryEditor *meditMemoryEditorNew() {
   editor->ReadFn = NULL;
   editor->WriteFn = NULL;
   editor->HighlightFn = NULL;
+  editor->HighlightColorFn = NULL;
+  editor->Arena = arena;
+  editor->Clipper = ImGuiListClipper_ImGuiListClipper();
 
   // State/Internals
   editor->ContentsWidthChanged = false;
@@ -308,6 +323,11 @@ GBMemoryEditor *meditMemoryEditorNew() {
   return editor;
 }
 
+void meditMemoryEditorFree(GBMemoryEditor *editor) {
+  ImGuiListClipper_destroy(editor->Clipper);
+  free(editor);
+}
+
 void meditGotoAddrAndHighlight(GBMemoryEditor *editor, size_t addr_min,
                                size_t addr_max) {
   editor->GotoAddr = addr_min;
@@ -318,7 +338,9 @@ void meditGotoAddrAndHighlight(GBMemoryEditor *editor, size_t addr_min,
 // Standalone Memory Editor window
 void meditDrawWindow(GBMemoryEditor *editor, const char *title, void *mem_data,
                      size_t mem_size, size_t base_display_addr) {
-  Sizes *s = meditNewSize();
+  Sizes *s = meditNewSize(editor);
+  if (s == NULL)
+    return; // skip a frame rather than draw without layout
   meditCalcSizes(editor, s, mem_size, base_display_addr);
 
   ImVec2 min;
@@ -345,7 +367,6 @@ void meditDrawWindow(GBMemoryEditor *editor, const char *title, void *mem_data,
     }
   }
   igEnd();
-  free(s); // TODO
 }
 
 // Memory Editor contents only
@@ -355,7 +376,9 @@ void meditDrawContents(GBMemoryEditor *editor, void *mem_data_void,
     editor->Cols = 1;
 
   ImU8 *mem_data = (ImU8 *)mem_data_void;
-  Sizes *s = meditNewSize(); // TODO
+  Sizes *s = meditNewSize(editor);
+  if (s == NULL)
+    return;
   meditCalcSizes(editor, s, mem_size, base_display_addr);
   ImGuiStyle *style = igGetStyle();
 
@@ -393,7 +416,7 @@ void meditDrawContents(GBMemoryEditor *editor, void *mem_data_void,
   // visible_start_addr/visible_end_addr for our scrolling function.
   const int line_total_count =
       (int)((mem_size + editor->Cols - 1) / editor->Cols);
-  ImGuiListClipper *clipper = ImGuiListClipper_ImGuiListClipper(); // TODO
+  ImGuiListClipper *clipper = editor->Clipper;
   ImGuiListClipper_Begin(clipper, line_total_count, s->LineHeight);
   ImGuiListClipper_Step(clipper);
   const size_t visible_start_addr = clipper->DisplayStart * editor->Cols;
@@ -517,8 +540,10 @@ void meditDrawContents(GBMemoryEditor *editor, void *mem_data_void,
         ImVec2 pmax;
         pmax.x = pos.x + highlight_width;
         pmax.y = pos.y + s->LineHeight;
-        ImDrawList_AddRectFilled(draw_list, pos, pmax, editor->HighlightColor,
-                                 0.f, 15);
+        ImU32 color = is_highlight_from_user_func && editor->HighlightColorFn
+                          ? editor->HighlightColorFn(mem_data, addr)
+                          : editor->HighlightColor;
+        ImDrawList_AddRectFilled(draw_list, pos, pmax, color, 0.f, 15);
       }
 
       if (editor->DataEditingAddr == addr) {
@@ -636,7 +661,6 @@ void meditDrawContents(GBMemoryEditor *editor, void *mem_data_void,
   }
   IM_ASSERT(ImGuiListClipper_Step(clipper) == false);
   ImGuiListClipper_End(clipper);
-  ImGuiListClipper_destroy(clipper); // TODO
   igPopStyleVar(2);
   igEndChild();
 
@@ -1,7 +1,7 @@
 #include "driver.h"
 
 int gbDriverInit(void) {
-  if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
     gbSetError("<<SDL_Init>> %s\n", SDL_GetError());
     return 1;
   }
@@ -37,24 +37,67 @@ GBDriver *gbDriverNew(int width, int height) {
 
   driver->raw = win;
   driver->context = context;
+  driver->callback = NULL;
+  driver->buttons = 0;
+  driver->audio = 0;
   return driver;
 }
 
 void gbDriverFree(GBDriver *driver) {
+  if (driver->audio != 0)
+    SDL_CloseAudioDevice(driver->audio);
   SDL_GL_DeleteContext(driver->context);
   SDL_DestroyWindow(driver->raw);
   free(driver);
 }
 
-void gbDriverDraw(GBDriver *driver) { SDL_GL_SwapWindow(driver->raw); }
+int gbDriverDraw(GBDriver *driver) {
+  SDL_GL_SwapWindow(driver->raw);
+  return 0;
+}
 
-static bool (*DriverCallback)(const SDL_Event *) = NULL;
+void gbDriverSetEventCallback(GBDriver *driver,
+                              bool (*Callback)(const SDL_Event *)) {
+  driver->callback = Callback;
+}
 
-void gbDriverSetEventCallback(bool (*Callback)(const SDL_Event *)) {
-  DriverCallback = Callback;
+static byte keyButton(SDL_Keycode key) {
+  switch (key) {
+  case SDLK_RIGHT:
+    return GB_BUTTON_RIGHT;
+  case SDLK_LEFT:
+    return GB_BUTTON_LEFT;
+  case SDLK_UP:
+    return GB_BUTTON_UP;
+  case SDLK_DOWN:
+    return GB_BUTTON_DOWN;
+  case SDLK_z:
+    return GB_BUTTON_A;
+  case SDLK_x:
+    return GB_BUTTON_B;
+  case SDLK_BACKSPACE:
+    return GB_BUTTON_SELECT;
+  case SDLK_RETURN:
+    return GB_BUTTON_START;
+  default:
+    return 0;
+  }
 }
 
-int gbDriverPollEvent(GBDriverEvent *event) {
+static int keyHotkey(SDL_Keycode key) {
+  switch (key) {
+  case SDLK_F9:
+    return GB_HOTKEY_TRACE;
+  case SDLK_F5:
+    return GB_HOTKEY_SAVE_STATE;
+  case SDLK_F12:
+    return GB_HOTKEY_SCREENSHOT;
+  default:
+    return -1;
+  }
+}
+
+int gbDriverPollEvent(GBDriver *driver, GBDriverEvent *event) {
   SDL_Event e;
   bool found = false;
   while (SDL_PollEvent(&e) != 0) {
@@ -76,10 +119,54 @@ int gbDriverPollEvent(GBDriverEvent *event) {
         found = true;
       }
     }
-    if (DriverCallback != NULL)
-      DriverCallback(&e);
+    if (e.type == SDL_KEYDOWN && e.key.repeat == 0 &&
+        keyHotkey(e.key.keysym.sym) >= 0) {
+      event->type = GB_DRIVER_HOTKEY;
+      event->hotkey = keyHotkey(e.key.keysym.sym);
+      found = true;
+    }
+    if ((e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) && e.key.repeat == 0) {
+      byte button = keyButton(e.key.keysym.sym);
+      if (button != 0) {
+        if (e.type == SDL_KEYDOWN)
+          driver->buttons |= button;
+        else
+          driver->buttons &= (byte)~button;
+        event->type = GB_DRIVER_INPUT;
+        event->buttons = driver->buttons;
+        found = true;
+      }
+    }
+    if (driver->callback != NULL)
+      driver->callback(&e);
     if (found)
       return true;
   }
   return 0;
-}
\ No newline at end of file
+}
+
+/* Runs on SDL's audio thread, the ring is the only state it touches */
+static void audioCallback(void *userdata, Uint8 *stream, int len) {
+  size_t read = gbRingRead(userdata, stream, (size_t)len);
+  memset(stream + read, 0, (size_t)len - read);
+}
+
+int gbDriverOpenAudio(GBDriver *driver, int rate, GBRing *ring) {
+  SDL_AudioSpec want;
+  SDL_zero(want);
+  want.freq = rate;
+  want.format = AUDIO_S16SYS;
+  want.channels = 2;
+  want.samples = 512;
+  want.callback = audioCallback;
+  want.userdata = ring;
+
+  /* SDL converts if the device wants another format */
+  driver->audio = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+  if (driver->audio == 0) {
+    gbSetError("<<SDL_OpenAudioDevice>> %s\n", SDL_GetError());
+    return 1;
+  }
+  SDL_PauseAudioDevice(driver->audio, 0);
+  return 0;
+}
@@ -7,6 +7,9 @@
 typedef struct {
   SDL_Window *raw;
   SDL_GLContext *context;
+  bool (*callback)(const SDL_Event *);
+  byte buttons; /* GBButton mask held on the keyboard */
+  SDL_AudioDeviceID audio; /* 0 until gbDriverOpenAudio */
 } GBDriver;
 
 int gbDriverInit(void);
@@ -17,8 +20,15 @@ uint32_t gbDriverGetTicks(void);
 GBDriver *gbDriverNew(int width, int height);
 void gbDriverFree(GBDriver *driver);
 
-void gbDriverDraw(GBDriver *driver);
+int gbDriverDraw(GBDriver *driver);
 
-void gbDriverSetEventCallback(bool (*Callback)(const SDL_Event *));
+void gbDriverSetEventCallback(GBDriver *driver,
+                              bool (*Callback)(const SDL_Event *));
 
-int gbDriverPollEvent(GBDriverEvent *event);
\ No newline at end of file
+int gbDriverPollEvent(GBDriver *driver, GBDriverEvent *event);
+
+/*
+ * Starts playing interleaved 16-bit stereo frames from ring, which the caller
+ * keeps filling from its own thread. Underruns play silence.
+ */
+int gbDriverOpenAudio(GBDriver *driver, int rate, GBRing *ring);
\ No newline at end of file
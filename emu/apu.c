@@ -0,0 +1,355 @@
+#include "apu.h"
+
+#include <string.h>
+
+#include "blip.h"
+#include "gb.h"
+
+/* Channel registers are five apart: NRx0 at 0xFF10 + 5 * (x - 1) */
+#define NR(channel, n) (GB_IO_NR10 + 5 * (channel) + (n))
+
+/* 15 (level) * 8 (master volume) * 4 channels stays well inside int16 */
+#define AMPLITUDE_SCALE 48
+
+enum { PULSE1, PULSE2, WAVE, NOISE };
+
+/* Bits of 0xFF10-0xFF2F that read back as 1, kept set in ram */
+static const byte ReadMasks[0x20] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF, /* NR10-NR14 */
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF, /* NR20-NR24 */
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF, /* NR30-NR34 */
+    0xFF, 0xFF, 0x00, 0x00, 0xBF, /* NR40-NR44 */
+    0x00, 0x00, 0x70, 0xFF, 0xFF, /* NR50-NR52, unused */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/* Pulse waveforms by NRx1 bits 6-7, step 0 in the top bit */
+static const byte Duties[4] = {0x01, 0x81, 0x87, 0x7E};
+
+static bool dacOn(const GB *gb, int channel) {
+  const byte *ram = gb->mem->ram;
+  if (channel == WAVE)
+    return ram[GB_IO_NR30] & 0x80;
+  return ram[NR(channel, 2)] & 0xF8;
+}
+
+/* Cycles between waveform steps, 0 when the channel never steps */
+static uint64_t stepCycles(const GB *gb, int channel) {
+  const GBApuChannel *c = &gb->apu.channels[channel];
+  if (channel == WAVE)
+    return (2048 - c->period) * 2;
+  if (channel != NOISE)
+    return (2048 - c->period) * 4;
+
+  byte nr43 = gb->mem->ram[GB_IO_NR43];
+  int shift = nr43 >> 4;
+  int divisor = nr43 & 7;
+  if (shift >= 14)
+    return 0;
+  return (uint64_t)(divisor != 0 ? divisor * 16 : 8) << shift;
+}
+
+/* Digital output, 0-15 */
+static int level(const GB *gb, int channel) {
+  const byte *ram = gb->mem->ram;
+  const GBApuChannel *c = &gb->apu.channels[channel];
+  if (!c->enabled)
+    return 0;
+
+  switch (channel) {
+  case WAVE: {
+    byte sample = ram[GB_IO_WAVE + c->position / 2];
+    sample = c->position & 1 ? sample & 0x0F : sample >> 4;
+    int code = (ram[GB_IO_NR32] >> 5) & 3;
+    return code != 0 ? sample >> (code - 1) : 0;
+  }
+  case NOISE:
+    return c->lfsr & 1 ? 0 : c->volume;
+  default:
+    return testBit(Duties[ram[NR(channel, 1)] >> 6], 7 - c->position)
+               ? c->volume
+               : 0;
+  }
+}
+
+/* True when stepping the waveform cannot change the output */
+static bool silent(const GB *gb, int channel) {
+  const GBApuChannel *c = &gb->apu.channels[channel];
+  if (!c->enabled)
+    return true;
+  if (channel == WAVE)
+    return (gb->mem->ram[GB_IO_NR32] & 0x60) == 0;
+  return c->volume == 0;
+}
+
+/* Mixes the channel's level and hands any change to the blip */
+static void report(GB *gb, int channel, uint64_t cycle) {
+  const byte *ram = gb->mem->ram;
+  GBApuChannel *c = &gb->apu.channels[channel];
+  byte nr50 = ram[GB_IO_NR50];
+  byte nr51 = ram[GB_IO_NR51];
+  int out = level(gb, channel) * AMPLITUDE_SCALE;
+
+  short left = testBit(nr51, 4 + channel) ? out * (((nr50 >> 4) & 7) + 1) : 0;
+  short right = testBit(nr51, channel) ? out * ((nr50 & 7) + 1) : 0;
+  if (left == c->amplitude[0] && right == c->amplitude[1])
+    return;
+  if (gb->blip != NULL)
+    gbBlipAddDelta(gb->blip, cycle, left - c->amplitude[0],
+                   right - c->amplitude[1]);
+  c->amplitude[0] = left;
+  c->amplitude[1] = right;
+}
+
+static void reportAll(GB *gb) {
+  for (int i = 0; i < GB_APU_CHANNELS; i++)
+    report(gb, i, gb->apu.time);
+
+  byte *ram = gb->mem->ram;
+  byte status = ram[GB_IO_NR52] & 0x80;
+  for (int i = 0; i < GB_APU_CHANNELS; i++)
+    if (gb->apu.channels[i].enabled)
+      status |= (byte)(1 << i);
+  ram[GB_IO_NR52] = status | ReadMasks[GB_IO_NR52 - GB_IO_NR10];
+}
+
+static void stepWaveform(GBApuChannel *c, int channel, byte nr43) {
+  switch (channel) {
+  case WAVE:
+    c->position = (c->position + 1) & 31;
+    break;
+  case NOISE: {
+    word bit = (c->lfsr ^ (c->lfsr >> 1)) & 1;
+    c->lfsr = (word)((c->lfsr >> 1) | (bit << 14));
+    if (nr43 & 0x08)
+      c->lfsr = (word)((c->lfsr & ~0x40) | (bit << 6));
+    break;
+  }
+  default:
+    c->position = (c->position + 1) & 7;
+    break;
+  }
+}
+
+/* Brings one channel's waveform up to until, between frame sequencer steps */
+static void run(GB *gb, int channel, uint64_t until) {
+  GBApuChannel *c = &gb->apu.channels[channel];
+  uint64_t cycles = stepCycles(gb, channel);
+  if (cycles == 0) {
+    c->next = until;
+    return;
+  }
+
+  /* Inaudible steps are skipped in one go. The noise LFSR is left alone, it
+   * restarts on every trigger anyway */
+  if (gb->blip == NULL || silent(gb, channel)) {
+    if (c->next <= until) {
+      uint64_t steps = (until - c->next) / cycles + 1;
+      c->next += steps * cycles;
+      c->position = (small)((c->position + steps) & (channel == WAVE ? 31 : 7));
+    }
+    return;
+  }
+
+  byte nr43 = gb->mem->ram[GB_IO_NR43];
+  while (c->next <= until) {
+    stepWaveform(c, channel, nr43);
+    report(gb, channel, c->next);
+    c->next += cycles;
+  }
+}
+
+/* Next sweep frequency from the shadow register, overflow disables */
+static int sweepTarget(GB *gb) {
+  GBApu *apu = &gb->apu;
+  byte nr10 = gb->mem->ram[GB_IO_NR10];
+  int delta = apu->sweepShadow >> (nr10 & 7);
+  int target = nr10 & 0x08 ? apu->sweepShadow - delta
+                           : apu->sweepShadow + delta;
+  if (target > 2047)
+    apu->channels[PULSE1].enabled = false;
+  return target;
+}
+
+static void clockSweep(GB *gb) {
+  GBApu *apu = &gb->apu;
+  byte nr10 = gb->mem->ram[GB_IO_NR10];
+  int period = (nr10 >> 4) & 7;
+  if (apu->sweepTimer == 0 || --apu->sweepTimer != 0)
+    return;
+
+  apu->sweepTimer = period != 0 ? period : 8;
+  if (!apu->sweepEnabled || period == 0)
+    return;
+  int target = sweepTarget(gb);
+  if (target <= 2047 && (nr10 & 7) != 0) {
+    apu->sweepShadow = (word)target;
+    apu->channels[PULSE1].period = (word)target;
+    sweepTarget(gb);
+  }
+}
+
+static void clockEnvelope(GB *gb, int channel) {
+  GBApuChannel *c = &gb->apu.channels[channel];
+  byte nrx2 = gb->mem->ram[NR(channel, 2)];
+  if (c->envelopeTimer == 0 || --c->envelopeTimer != 0)
+    return;
+
+  c->envelopeTimer = nrx2 & 7;
+  if ((nrx2 & 0x08) && c->volume < 15)
+    c->volume++;
+  else if (!(nrx2 & 0x08) && c->volume > 0)
+    c->volume--;
+}
+
+static void clockSequencer(GB *gb) {
+  GBApu *apu = &gb->apu;
+  const byte *ram = gb->mem->ram;
+  small step = apu->sequencerStep;
+  apu->sequencerStep = (step + 1) & 7;
+  if (!(ram[GB_IO_NR52] & 0x80))
+    return;
+
+  if ((step & 1) == 0) {
+    for (int i = 0; i < GB_APU_CHANNELS; i++) {
+      GBApuChannel *c = &apu->channels[i];
+      if ((ram[NR(i, 4)] & 0x40) && c->length > 0 && --c->length == 0)
+        c->enabled = false;
+    }
+  }
+  if (step == 2 || step == 6)
+    clockSweep(gb);
+  if (step == 7) {
+    clockEnvelope(gb, PULSE1);
+    clockEnvelope(gb, PULSE2);
+    clockEnvelope(gb, NOISE);
+  }
+  reportAll(gb);
+}
+
+void gbApuSync(GB *gb) {
+  GBApu *apu = &gb->apu;
+  if (apu->time >= gb->cycles)
+    return;
+
+  GB_PROFILE_BEGIN(GB_PROFILE_APU);
+  while (apu->time < gb->cycles) {
+    if (apu->sequencerNext <= apu->time) {
+      clockSequencer(gb);
+      apu->sequencerNext += GB_APU_SEQUENCER_CYCLES;
+      continue;
+    }
+    uint64_t until = apu->sequencerNext < gb->cycles ? apu->sequencerNext
+                                                     : gb->cycles;
+    for (int i = 0; i < GB_APU_CHANNELS; i++)
+      run(gb, i, until);
+    apu->time = until;
+  }
+  GB_PROFILE_END();
+}
+
+static void trigger(GB *gb, int channel) {
+  GBApu *apu = &gb->apu;
+  GBApuChannel *c = &apu->channels[channel];
+  byte nrx2 = gb->mem->ram[NR(channel, 2)];
+
+  c->enabled = dacOn(gb, channel);
+  if (c->length == 0)
+    c->length = channel == WAVE ? 256 : 64;
+  c->next = apu->time + stepCycles(gb, channel);
+  c->volume = nrx2 >> 4;
+  c->envelopeTimer = nrx2 & 7;
+  if (channel == WAVE)
+    c->position = 0;
+  c->lfsr = 0x7FFF;
+
+  if (channel == PULSE1) {
+    byte nr10 = gb->mem->ram[GB_IO_NR10];
+    int period = (nr10 >> 4) & 7;
+    apu->sweepShadow = c->period;
+    apu->sweepTimer = period != 0 ? period : 8;
+    apu->sweepEnabled = period != 0 || (nr10 & 7) != 0;
+    if (nr10 & 7)
+      sweepTarget(gb);
+  }
+}
+
+static void powerOff(GB *gb) {
+  byte *ram = gb->mem->ram;
+  for (addr a = GB_IO_NR10; a < GB_IO_NR52; a++)
+    ram[a] = ReadMasks[a - GB_IO_NR10];
+  for (int i = 0; i < GB_APU_CHANNELS; i++) {
+    GBApuChannel *c = &gb->apu.channels[i];
+    /* the amplitudes are what the blip holds, they fall to 0 via report */
+    *c = (GBApuChannel){.amplitude = {c->amplitude[0], c->amplitude[1]}};
+  }
+  gb->apu.sweepEnabled = false;
+}
+
+void gbApuWrite(GB *gb, addr address, byte value) {
+  byte *ram = gb->mem->ram;
+  gbApuSync(gb);
+
+  if (address >= GB_IO_WAVE) {
+    ram[address] = value;
+    return;
+  }
+
+  bool power = ram[GB_IO_NR52] & 0x80;
+  if (address == GB_IO_NR52) {
+    if (power && !(value & 0x80))
+      powerOff(gb);
+    if (!power && (value & 0x80))
+      gb->apu.sequencerStep = 0;
+    ram[GB_IO_NR52] = value & 0x80;
+    reportAll(gb);
+    return;
+  }
+  if (!power)
+    return;
+  ram[address] = value | ReadMasks[address - GB_IO_NR10];
+
+  int channel = (address - GB_IO_NR10) / 5;
+  int n = (address - GB_IO_NR10) % 5;
+  GBApuChannel *c = channel < GB_APU_CHANNELS ? &gb->apu.channels[channel]
+                                              : NULL;
+  if (c != NULL) {
+    switch (n) {
+    case 0:
+      if (channel == WAVE && !dacOn(gb, WAVE))
+        c->enabled = false;
+      break;
+    case 1:
+      c->length = channel == WAVE ? 256 - value : 64 - (value & 0x3F);
+      break;
+    case 2:
+      if (channel != WAVE && !dacOn(gb, channel))
+        c->enabled = false;
+      break;
+    case 3:
+      if (channel != NOISE)
+        c->period = (word)((c->period & 0x700) | value);
+      break;
+    case 4:
+      if (channel != NOISE)
+        c->period = (word)((c->period & 0xFF) | ((value & 7) << 8));
+      if (value & 0x80)
+        trigger(gb, channel);
+      break;
+    }
+  }
+  reportAll(gb);
+}
+
+void gbApuEndFrame(GB *gb) {
+  gbApuSync(gb);
+  if (gb->blip != NULL)
+    gbBlipEndFrame(gb->blip, gb->apu.time);
+}
+
+void gbApuReset(GB *gb) {
+  memset(&gb->apu, 0, sizeof(GBApu));
+  gb->apu.sequencerNext = GB_APU_SEQUENCER_CYCLES;
+  for (addr a = GB_IO_NR10; a < GB_IO_WAVE; a++)
+    gb->mem->ram[a] = ReadMasks[a - GB_IO_NR10];
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "common.h"
+#include "mem.h"
+
+#define GB_APU_CHANNELS 4 /* pulse with sweep, pulse, wave, noise */
+
+/* Frame sequencer period, 512 Hz */
+#define GB_APU_SEQUENCER_CYCLES 8192
+
+/*
+ * The APU is not ticked with the CPU. Channels are brought up to date lazily,
+ * from the last synchronized cycle to now, whenever a sound register is
+ * written or NR52 is read and once per frame; between those points each
+ * channel only does work at its own waveform steps and reports the ones that
+ * change its output to gb->blip. Without a blip the steps are skipped
+ * arithmetically. Register values live in ram like the rest of the I/O page,
+ * stored with the bits that read back as 1 already set.
+ */
+
+typedef struct {
+  bool enabled; /* NR52 status bit */
+  word length;  /* length clocks left, counted while NRx4 bit 6 is set */
+  byte volume;  /* envelope output, 0-15 */
+  small envelopeTimer;
+  word period;   /* 11-bit frequency, updated by the sweep on channel 1 */
+  uint64_t next; /* cycle of the next waveform step */
+  small position; /* duty step 0-7 or wave sample 0-31 */
+  word lfsr;
+  short amplitude[2]; /* last reported to the blip, left and right */
+} GBApuChannel;
+
+typedef struct {
+  GBApuChannel channels[GB_APU_CHANNELS];
+  uint64_t time;          /* cycle the channels are synthesized up to */
+  uint64_t sequencerNext; /* cycle of the next frame sequencer step */
+  small sequencerStep;
+  bool sweepEnabled;
+  small sweepTimer;
+  word sweepShadow;
+} GBApu;
+
+struct GB;
+
+/* Power-on state, the sound circuit starts switched off */
+void gbApuReset(struct GB *gb);
+void gbApuSync(struct GB *gb);
+void gbApuWrite(struct GB *gb, addr address, byte value);
+/* Synchronizes and hands the frame's samples to the blip */
+void gbApuEndFrame(struct GB *gb);
@@ -0,0 +1,132 @@
+#include "batch.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct GBBatch {
+  pthread_t *threads;
+  int threadCount;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  uint64_t generation; /* bumped for every gbBatchRunFrame call */
+  int busy;            /* workers still inside the current generation */
+  bool quit;
+
+  /* current job */
+  GB **gbs;
+  size_t count;
+  byte *framebuffers;
+  atomic_size_t next;
+};
+
+static void runJobs(GBBatch *batch) {
+  size_t i;
+  while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+    GB *gb = batch->gbs[i];
+    gbRunFrame(gb);
+    if (batch->framebuffers != NULL)
+      memcpy(batch->framebuffers + i * GB_FRAMEBUFFER_SIZE,
+             gbGetFramebuffer(gb), GB_FRAMEBUFFER_SIZE);
+  }
+}
+
+static void *worker(void *arg) {
+  GBBatch *batch = arg;
+  uint64_t seen = 0;
+  gbTraceSetThreadName("batch");
+
+  pthread_mutex_lock(&batch->lock);
+  for (;;) {
+    while (!batch->quit && batch->generation == seen)
+      pthread_cond_wait(&batch->wake, &batch->lock);
+    if (batch->quit)
+      break;
+    seen = batch->generation;
+    pthread_mutex_unlock(&batch->lock);
+
+    runJobs(batch);
+
+    pthread_mutex_lock(&batch->lock);
+    if (--batch->busy == 0)
+      pthread_cond_signal(&batch->done);
+  }
+  pthread_mutex_unlock(&batch->lock);
+  return NULL;
+}
+
+GBBatch *gbBatchNew(int threads) {
+  if (threads < 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 1 ? (int)cpus - 1 : 0;
+  }
+
+  GBBatch *batch = malloc(sizeof(GBBatch));
+  if (batch == NULL) {
+    gbSetError("<<gbBatchNew>> out of memory");
+    return NULL;
+  }
+  memset(batch, 0, sizeof(GBBatch));
+  atomic_init(&batch->next, 0);
+
+  pthread_mutex_init(&batch->lock, NULL);
+  pthread_cond_init(&batch->wake, NULL);
+  pthread_cond_init(&batch->done, NULL);
+
+  batch->threads = malloc(sizeof(pthread_t) * (threads > 0 ? threads : 1));
+  if (batch->threads == NULL) {
+    gbSetError("<<gbBatchNew>> out of memory");
+    gbBatchFree(batch);
+    return NULL;
+  }
+  for (int i = 0; i < threads; i++) {
+    if (pthread_create(&batch->threads[i], NULL, worker, batch) != 0) {
+      gbSetError("<<gbBatchNew>> cannot start worker %d", i);
+      gbBatchFree(batch);
+      return NULL;
+    }
+    batch->threadCount++;
+  }
+  return batch;
+}
+
+void gbBatchFree(GBBatch *batch) {
+  pthread_mutex_lock(&batch->lock);
+  batch->quit = true;
+  pthread_cond_broadcast(&batch->wake);
+  pthread_mutex_unlock(&batch->lock);
+
+  for (int i = 0; i < batch->threadCount; i++)
+    pthread_join(batch->threads[i], NULL);
+
+  pthread_cond_destroy(&batch->done);
+  pthread_cond_destroy(&batch->wake);
+  pthread_mutex_destroy(&batch->lock);
+  free(batch->threads);
+  free(batch);
+}
+
+void gbBatchRunFrame(GBBatch *batch, GB **gbs, size_t count,
+                     byte *framebuffers) {
+  pthread_mutex_lock(&batch->lock);
+  batch->gbs = gbs;
+  batch->count = count;
+  batch->framebuffers = framebuffers;
+  atomic_store(&batch->next, 0);
+  batch->busy = batch->threadCount;
+  batch->generation++;
+  pthread_cond_broadcast(&batch->wake);
+  pthread_mutex_unlock(&batch->lock);
+
+  runJobs(batch);
+
+  pthread_mutex_lock(&batch->lock);
+  while (batch->busy != 0)
+    pthread_cond_wait(&batch->done, &batch->lock);
+  pthread_mutex_unlock(&batch->lock);
+}
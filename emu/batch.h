@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "gb.h"
+
+/*
+ * A persistent worker pool that advances many GB instances by one frame each.
+ * The calling thread takes part in the work, so a pool of N threads uses
+ * N + 1 cores while gbBatchRunFrame is running. Opaque so embedders don't
+ * depend on its layout.
+ */
+typedef struct GBBatch GBBatch;
+
+/* threads < 0 starts one worker per online CPU besides the caller */
+GBBatch *gbBatchNew(int threads);
+void gbBatchFree(GBBatch *batch);
+
+/*
+ * Runs gbRunFrame on every instance and, if framebuffers is not NULL, copies
+ * instance i's framebuffer to framebuffers + i * GB_FRAMEBUFFER_SIZE.
+ */
+void gbBatchRunFrame(GBBatch *batch, GB **gbs, size_t count,
+                     byte *framebuffers);
@@ -0,0 +1,166 @@
+#include "blip.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define DELTA_BITS 15 /* kernel taps sum to 1 << DELTA_BITS */
+#define BASS_SHIFT 9  /* integrator leak, a high-pass around 15 Hz at 48k */
+#define CUTOFF 0.45   /* of the output rate, a little under Nyquist */
+#define PHASE_SHIFT (32 - 5)
+#define PI 3.14159265358979323846
+
+_Static_assert(GB_BLIP_PHASES == 1 << (32 - PHASE_SHIFT),
+               "phase bits match GB_BLIP_PHASES");
+
+static double blackman(double x) {
+  /* x in -1..1 over the window */
+  return 0.42 + 0.5 * cos(PI * x) + 0.08 * cos(2 * PI * x);
+}
+
+static void buildKernel(GBBlip *blip) {
+  const int half = GB_BLIP_TAPS / 2;
+  for (int phase = 0; phase < GB_BLIP_PHASES; phase++) {
+    double taps[GB_BLIP_TAPS];
+    double sum = 0;
+    for (int i = 0; i < GB_BLIP_TAPS; i++) {
+      /* impulses sit half the kernel after the step's own sample */
+      double x = i - half - (double)phase / GB_BLIP_PHASES;
+      double sinc = x == 0 ? 1 : sin(2 * PI * CUTOFF * x) /
+                                     (2 * PI * CUTOFF * x);
+      taps[i] = 2 * CUTOFF * sinc * blackman(x / half);
+      sum += taps[i];
+    }
+
+    /* Normalize after rounding so a step always integrates to its size */
+    int total = 0;
+    int peak = 0;
+    for (int i = 0; i < GB_BLIP_TAPS; i++) {
+      blip->kernel[phase][i] =
+          (int16_t)lround(taps[i] / sum * (1 << DELTA_BITS));
+      total += blip->kernel[phase][i];
+      if (blip->kernel[phase][i] > blip->kernel[phase][peak])
+        peak = i;
+    }
+    blip->kernel[phase][peak] += (1 << DELTA_BITS) - total;
+  }
+}
+
+GBBlip *gbBlipNew(double clockRate, double sampleRate, size_t capacity) {
+  GBBlip *blip = malloc(sizeof(GBBlip));
+  if (blip == NULL) {
+    gbSetError("<<gbBlipNew>> out of memory");
+    return NULL;
+  }
+  memset(blip, 0, sizeof(GBBlip));
+  blip->capacity = capacity;
+  for (int c = 0; c < 2; c++) {
+    blip->deltas[c] = calloc(capacity + GB_BLIP_TAPS, sizeof(int32_t));
+    if (blip->deltas[c] == NULL) {
+      gbSetError("<<gbBlipNew>> out of memory");
+      gbBlipFree(blip);
+      return NULL;
+    }
+  }
+  buildKernel(blip);
+  gbBlipSetRates(blip, clockRate, sampleRate);
+  return blip;
+}
+
+void gbBlipFree(GBBlip *blip) {
+  free(blip->deltas[0]);
+  free(blip->deltas[1]);
+  free(blip);
+}
+
+void gbBlipSetRates(GBBlip *blip, double clockRate, double sampleRate) {
+  blip->factor = (uint64_t)(sampleRate / clockRate * 4294967296.0 + 0.5);
+}
+
+void gbBlipSetTime(GBBlip *blip, uint64_t clock) { blip->start = clock; }
+
+#ifdef __SSE2__
+/* out[0..7] += k * d, 16x16 bit products widened to 32 bits */
+static void addProducts(int32_t *out, __m128i k, __m128i d) {
+  __m128i lo = _mm_mullo_epi16(k, d);
+  __m128i hi = _mm_mulhi_epi16(k, d);
+  __m128i *p = (__m128i *)out;
+  _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p),
+                                    _mm_unpacklo_epi16(lo, hi)));
+  _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1),
+                                        _mm_unpackhi_epi16(lo, hi)));
+}
+#endif
+
+void gbBlipAddDelta(GBBlip *blip, uint64_t clock, int left, int right) {
+  if (clock < blip->start)
+    clock = blip->start;
+  uint64_t position = blip->offset + (clock - blip->start) * blip->factor;
+  size_t index = (size_t)(position >> 32);
+  if (index >= blip->capacity)
+    return;
+
+  const int16_t *kernel =
+      blip->kernel[(position >> PHASE_SHIFT) & (GB_BLIP_PHASES - 1)];
+  int32_t *l = blip->deltas[0] + index;
+  int32_t *r = blip->deltas[1] + index;
+#ifdef __SSE2__
+  __m128i dl = _mm_set1_epi16((short)left);
+  __m128i dr = _mm_set1_epi16((short)right);
+  for (int i = 0; i < GB_BLIP_TAPS; i += 8) {
+    __m128i k = _mm_loadu_si128((const __m128i *)(kernel + i));
+    addProducts(l + i, k, dl);
+    addProducts(r + i, k, dr);
+  }
+#else
+  for (int i = 0; i < GB_BLIP_TAPS; i++) {
+    l[i] += left * kernel[i];
+    r[i] += right * kernel[i];
+  }
+#endif
+}
+
+void gbBlipEndFrame(GBBlip *blip, uint64_t clock) {
+  if (clock < blip->start)
+    clock = blip->start;
+  blip->offset += (clock - blip->start) * blip->factor;
+  blip->start = clock;
+  if ((blip->offset >> 32) > blip->capacity)
+    blip->offset = (uint64_t)blip->capacity << 32;
+}
+
+size_t gbBlipAvailable(const GBBlip *blip) {
+  return (size_t)(blip->offset >> 32);
+}
+
+size_t gbBlipRead(GBBlip *blip, int16_t *out, size_t frames) {
+  size_t available = gbBlipAvailable(blip);
+  if (frames > available)
+    frames = available;
+
+  for (int c = 0; c < 2; c++) {
+    int32_t *deltas = blip->deltas[c];
+    int32_t sum = blip->integrator[c];
+    for (size_t i = 0; i < frames; i++) {
+      sum += deltas[i];
+      int32_t s = sum >> DELTA_BITS;
+      if (s < INT16_MIN)
+        s = INT16_MIN;
+      if (s > INT16_MAX)
+        s = INT16_MAX;
+      out[i * 2 + c] = (int16_t)s;
+      sum -= s * (1 << (DELTA_BITS - BASS_SHIFT));
+    }
+    blip->integrator[c] = sum;
+
+    size_t remaining = available - frames + GB_BLIP_TAPS;
+    memmove(deltas, deltas + frames, remaining * sizeof(int32_t));
+    memset(deltas + remaining, 0, frames * sizeof(int32_t));
+  }
+  blip->offset -= (uint64_t)frames << 32;
+  return frames;
+}
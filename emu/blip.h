@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/*
+ * Band-limited synthesis buffer. The APU does not produce samples; it reports
+ * the cycle at which a channel's output steps and by how much, and the step is
+ * added here as a windowed-sinc impulse at the matching fractional output
+ * sample. Reading integrates the impulses back into a band-limited waveform
+ * and removes DC, so the cost is per step and not per emulated cycle. The
+ * kernel is a polyphase filter, so any clock to sample rate ratio works and
+ * retuning it costs nothing. Stereo, with an 8 sample delay from the kernel's
+ * half width.
+ */
+
+#define GB_BLIP_PHASES 32 /* sub-sample positions of the kernel */
+#define GB_BLIP_TAPS 16
+
+typedef struct GBBlip {
+  uint64_t factor; /* output samples per clock, 32.32 fixed point */
+  uint64_t offset; /* position of start in output samples, 32.32 */
+  uint64_t start;  /* clock the pending frame began at */
+  size_t capacity; /* samples, excluding the kernel tail */
+  int32_t integrator[2];
+  int32_t *deltas[2]; /* capacity + GB_BLIP_TAPS per channel */
+  int16_t kernel[GB_BLIP_PHASES][GB_BLIP_TAPS];
+} GBBlip;
+
+GBBlip *gbBlipNew(double clockRate, double sampleRate, size_t capacity);
+void gbBlipFree(GBBlip *blip);
+
+/*
+ * Only between frames. Nudging sampleRate a fraction of a percent is how the
+ * front end resamples to match the audio device's real clock
+ */
+void gbBlipSetRates(GBBlip *blip, double clockRate, double sampleRate);
+/*
+ * Rebases the pending frame: when attaching to a GB (at gb->apu.time) and
+ * after a save state moved its clock
+ */
+void gbBlipSetTime(GBBlip *blip, uint64_t clock);
+
+/*
+ * left and right must fit in 16 bits. Steps past the capacity are dropped,
+ * read often enough to avoid that
+ */
+void gbBlipAddDelta(GBBlip *blip, uint64_t clock, int left, int right);
+/* Makes everything before clock readable */
+void gbBlipEndFrame(GBBlip *blip, uint64_t clock);
+
+size_t gbBlipAvailable(const GBBlip *blip);
+/* Interleaved stereo, returns the number of frames read */
+size_t gbBlipRead(GBBlip *blip, int16_t *out, size_t frames);
@@ -0,0 +1,572 @@
+#include "cpu.h"
+
+#include "debug.h"
+#include "gb.h"
+#include "hotspot.h"
+#include "itrace.h"
+
+/*
+ * Opcodes are decoded by their octal fields: x = op[7:6], y = op[5:3],
+ * z = op[2:0], p = y >> 1, q = y & 1. 8-bit register operands use the
+ * B C D E H L (HL) A ordering, with index 6 being the byte at HL.
+ */
+
+#define R8_HL 6
+
+static byte fetch(GB *gb) { return gbRead(gb, gb->cpu.regs.pc++); }
+
+static word fetch16(GB *gb) {
+  byte lo = fetch(gb);
+  byte hi = fetch(gb);
+  return (word)(lo | (hi << 8));
+}
+
+static void push(GB *gb, word value) {
+  GBRegisters *r = &gb->cpu.regs;
+  gbWrite(gb, --r->sp, value >> 8);
+  gbWrite(gb, --r->sp, value & 0xFF);
+}
+
+static word pop(GB *gb) {
+  GBRegisters *r = &gb->cpu.regs;
+  byte lo = gbRead(gb, r->sp++);
+  byte hi = gbRead(gb, r->sp++);
+  return (word)(lo | (hi << 8));
+}
+
+static byte getR8(GB *gb, small index) {
+  GBRegisters *r = &gb->cpu.regs;
+  switch (index) {
+  case 0:
+    return r->b;
+  case 1:
+    return r->c;
+  case 2:
+    return r->d;
+  case 3:
+    return r->e;
+  case 4:
+    return r->h;
+  case 5:
+    return r->l;
+  case R8_HL:
+    return gbRead(gb, r->hl);
+  default:
+    return r->a;
+  }
+}
+
+static void setR8(GB *gb, small index, byte value) {
+  GBRegisters *r = &gb->cpu.regs;
+  switch (index) {
+  case 0:
+    r->b = value;
+    break;
+  case 1:
+    r->c = value;
+    break;
+  case 2:
+    r->d = value;
+    break;
+  case 3:
+    r->e = value;
+    break;
+  case 4:
+    r->h = value;
+    break;
+  case 5:
+    r->l = value;
+    break;
+  case R8_HL:
+    gbWrite(gb, r->hl, value);
+    break;
+  default:
+    r->a = value;
+    break;
+  }
+}
+
+/* BC DE HL SP */
+static word *rp(GB *gb, small p) {
+  GBRegisters *r = &gb->cpu.regs;
+  switch (p) {
+  case 0:
+    return &r->bc;
+  case 1:
+    return &r->de;
+  case 2:
+    return &r->hl;
+  default:
+    return &r->sp;
+  }
+}
+
+/* NZ Z NC C */
+static bool condition(GB *gb, small cc) {
+  byte f = gb->cpu.regs.f;
+  switch (cc) {
+  case 0:
+    return !(f & GB_FLAG_Z);
+  case 1:
+    return (f & GB_FLAG_Z) != 0;
+  case 2:
+    return !(f & GB_FLAG_C);
+  default:
+    return (f & GB_FLAG_C) != 0;
+  }
+}
+
+static byte flags(bool z, bool n, bool h, bool c) {
+  return (byte)((z ? GB_FLAG_Z : 0) | (n ? GB_FLAG_N : 0) |
+                (h ? GB_FLAG_H : 0) | (c ? GB_FLAG_C : 0));
+}
+
+/* ADD ADC SUB SBC AND XOR OR CP */
+static void alu(GB *gb, small op, byte value) {
+  GBRegisters *r = &gb->cpu.regs;
+  byte a = r->a;
+  byte carry = (r->f & GB_FLAG_C) ? 1 : 0;
+  int res;
+
+  switch (op) {
+  case 0:
+  case 1:
+    if (op == 0)
+      carry = 0;
+    res = a + value + carry;
+    r->a = (byte)res;
+    r->f = flags(r->a == 0, false, ((a & 0xF) + (value & 0xF) + carry) > 0xF,
+                 res > 0xFF);
+    break;
+  case 2:
+  case 3:
+  case 7:
+    if (op != 3)
+      carry = 0;
+    res = a - value - carry;
+    r->f = flags((byte)res == 0, true, ((a & 0xF) - (value & 0xF) - carry) < 0,
+                 res < 0);
+    if (op != 7)
+      r->a = (byte)res;
+    break;
+  case 4:
+    r->a = a & value;
+    r->f = flags(r->a == 0, false, true, false);
+    break;
+  case 5:
+    r->a = a ^ value;
+    r->f = flags(r->a == 0, false, false, false);
+    break;
+  case 6:
+    r->a = a | value;
+    r->f = flags(r->a == 0, false, false, false);
+    break;
+  }
+}
+
+/* RLC RRC RL RR SLA SRA SWAP SRL, sets Z */
+static byte rot(GB *gb, small op, byte v) {
+  GBRegisters *r = &gb->cpu.regs;
+  bool carryIn = (r->f & GB_FLAG_C) != 0;
+  bool carry = false;
+  byte res = 0;
+
+  switch (op) {
+  case 0:
+    carry = v >> 7;
+    res = (byte)((v << 1) | carry);
+    break;
+  case 1:
+    carry = v & 1;
+    res = (byte)((v >> 1) | (carry << 7));
+    break;
+  case 2:
+    carry = v >> 7;
+    res = (byte)((v << 1) | carryIn);
+    break;
+  case 3:
+    carry = v & 1;
+    res = (byte)((v >> 1) | (carryIn << 7));
+    break;
+  case 4:
+    carry = v >> 7;
+    res = (byte)(v << 1);
+    break;
+  case 5:
+    carry = v & 1;
+    res = (byte)((v >> 1) | (v & 0x80));
+    break;
+  case 6:
+    res = (byte)((v << 4) | (v >> 4));
+    break;
+  case 7:
+    carry = v & 1;
+    res = v >> 1;
+    break;
+  }
+
+  r->f = flags(res == 0, false, false, carry);
+  return res;
+}
+
+static word addSigned(GB *gb, word base) {
+  byte e = fetch(gb);
+  gb->cpu.regs.f = flags(false, false, ((base & 0xF) + (e & 0xF)) > 0xF,
+                         ((base & 0xFF) + e) > 0xFF);
+  return (word)(base + (signed char)e);
+}
+
+static void daa(GBRegisters *r) {
+  byte a = r->a;
+  bool carry = (r->f & GB_FLAG_C) != 0;
+
+  if (!(r->f & GB_FLAG_N)) {
+    if (carry || a > 0x99) {
+      a += 0x60;
+      carry = true;
+    }
+    if ((r->f & GB_FLAG_H) || (a & 0x0F) > 0x09)
+      a += 0x06;
+  } else {
+    if (carry)
+      a -= 0x60;
+    if (r->f & GB_FLAG_H)
+      a -= 0x06;
+  }
+
+  r->a = a;
+  r->f = flags(a == 0, (r->f & GB_FLAG_N) != 0, false, carry);
+}
+
+static int executeCB(GB *gb) {
+  byte op = fetch(gb);
+  small x = op >> 6;
+  small y = (op >> 3) & 7;
+  small z = op & 7;
+  byte v = getR8(gb, z);
+
+  switch (x) {
+  case 0:
+    setR8(gb, z, rot(gb, y, v));
+    break;
+  case 1:
+    gb->cpu.regs.f = (byte)(flags(!testBit(v, y), false, true, false) |
+                            (gb->cpu.regs.f & GB_FLAG_C));
+    return z == R8_HL ? 12 : 8;
+  case 2:
+    setR8(gb, z, clearBit(v, y));
+    break;
+  case 3:
+    setR8(gb, z, setBit(v, y));
+    break;
+  }
+  return z == R8_HL ? 16 : 8;
+}
+
+static int execute(GB *gb, byte op) {
+  GBRegisters *r = &gb->cpu.regs;
+  small x = op >> 6;
+  small y = (op >> 3) & 7;
+  small z = op & 7;
+  small p = y >> 1;
+  small q = y & 1;
+
+  switch (x) {
+  case 0:
+    switch (z) {
+    case 0:
+      switch (y) {
+      case 0: /* NOP */
+        return 4;
+      case 1: { /* LD (a16),SP */
+        word a = fetch16(gb);
+        gbWrite(gb, a, r->sp & 0xFF);
+        gbWrite(gb, (word)(a + 1), r->sp >> 8);
+        return 20;
+      }
+      case 2: /* STOP */
+        fetch(gb);
+        return 4;
+      case 3: { /* JR e */
+        signed char e = (signed char)fetch(gb);
+        r->pc = (word)(r->pc + e);
+        return 12;
+      }
+      default: { /* JR cc,e */
+        signed char e = (signed char)fetch(gb);
+        if (!condition(gb, y - 4))
+          return 8;
+        r->pc = (word)(r->pc + e);
+        return 12;
+      }
+      }
+    case 1:
+      if (q == 0) { /* LD rr,d16 */
+        *rp(gb, p) = fetch16(gb);
+        return 12;
+      } else { /* ADD HL,rr */
+        word v = *rp(gb, p);
+        int res = r->hl + v;
+        bool half = ((r->hl & 0xFFF) + (v & 0xFFF)) > 0xFFF;
+        r->f = (byte)((r->f & GB_FLAG_Z) |
+                      flags(false, false, half, res > 0xFFFF));
+        r->hl = (word)res;
+        return 8;
+      }
+    case 2: {
+      word a;
+      switch (p) {
+      case 0:
+        a = r->bc;
+        break;
+      case 1:
+        a = r->de;
+        break;
+      case 2:
+        a = r->hl++;
+        break;
+      default:
+        a = r->hl--;
+        break;
+      }
+      if (q == 0)
+        gbWrite(gb, a, r->a);
+      else
+        r->a = gbRead(gb, a);
+      return 8;
+    }
+    case 3:
+      if (q == 0)
+        (*rp(gb, p))++;
+      else
+        (*rp(gb, p))--;
+      return 8;
+    case 4: { /* INC r */
+      byte v = getR8(gb, y);
+      byte res = (byte)(v + 1);
+      setR8(gb, y, res);
+      r->f = (byte)((r->f & GB_FLAG_C) |
+                    flags(res == 0, false, (v & 0xF) == 0xF, false));
+      return y == R8_HL ? 12 : 4;
+    }
+    case 5: { /* DEC r */
+      byte v = getR8(gb, y);
+      byte res = (byte)(v - 1);
+      setR8(gb, y, res);
+      r->f = (byte)((r->f & GB_FLAG_C) |
+                    flags(res == 0, true, (v & 0xF) == 0, false));
+      return y == R8_HL ? 12 : 4;
+    }
+    case 6: /* LD r,d8 */
+      setR8(gb, y, fetch(gb));
+      return y == R8_HL ? 12 : 8;
+    default:
+      switch (y) {
+      case 0:
+      case 1:
+      case 2:
+      case 3: /* RLCA RRCA RLA RRA */
+        r->a = rot(gb, y, r->a);
+        r->f &= ~GB_FLAG_Z;
+        break;
+      case 4:
+        daa(r);
+        break;
+      case 5: /* CPL */
+        r->a = ~r->a;
+        r->f |= GB_FLAG_N | GB_FLAG_H;
+        break;
+      case 6: /* SCF */
+        r->f = (byte)((r->f & GB_FLAG_Z) | GB_FLAG_C);
+        break;
+      default: /* CCF */
+        r->f = (byte)((r->f & (GB_FLAG_Z | GB_FLAG_C)) ^ GB_FLAG_C);
+        break;
+      }
+      return 4;
+    }
+
+  case 1:
+    if (y == R8_HL && z == R8_HL) { /* HALT */
+      gb->cpu.halted = true;
+      return 4;
+    }
+    setR8(gb, y, getR8(gb, z));
+    return (y == R8_HL || z == R8_HL) ? 8 : 4;
+
+  case 2:
+    alu(gb, y, getR8(gb, z));
+    return z == R8_HL ? 8 : 4;
+
+  default:
+    switch (z) {
+    case 0:
+      switch (y) {
+      case 4: /* LDH (a8),A */
+        gbWrite(gb, (word)(0xFF00 | fetch(gb)), r->a);
+        return 12;
+      case 5: /* ADD SP,e */
+        r->sp = addSigned(gb, r->sp);
+        return 16;
+      case 6: /* LDH A,(a8) */
+        r->a = gbRead(gb, (word)(0xFF00 | fetch(gb)));
+        return 12;
+      case 7: /* LD HL,SP+e */
+        r->hl = addSigned(gb, r->sp);
+        return 12;
+      default: /* RET cc */
+        if (!condition(gb, y))
+          return 8;
+        r->pc = pop(gb);
+        return 20;
+      }
+    case 1:
+      if (q == 0) { /* POP rr */
+        word v = pop(gb);
+        if (p == 3)
+          r->af = v & 0xFFF0;
+        else
+          *rp(gb, p) = v;
+        return 12;
+      }
+      switch (p) {
+      case 0: /* RET */
+        r->pc = pop(gb);
+        return 16;
+      case 1: /* RETI */
+        r->pc = pop(gb);
+        gb->cpu.ime = true;
+        return 16;
+      case 2: /* JP HL */
+        r->pc = r->hl;
+        return 4;
+      default: /* LD SP,HL */
+        r->sp = r->hl;
+        return 8;
+      }
+    case 2:
+      switch (y) {
+      case 4: /* LD (C),A */
+        gbWrite(gb, (word)(0xFF00 | r->c), r->a);
+        return 8;
+      case 5: /* LD (a16),A */
+        gbWrite(gb, fetch16(gb), r->a);
+        return 16;
+      case 6: /* LD A,(C) */
+        r->a = gbRead(gb, (word)(0xFF00 | r->c));
+        return 8;
+      case 7: /* LD A,(a16) */
+        r->a = gbRead(gb, fetch16(gb));
+        return 16;
+      default: { /* JP cc,a16 */
+        word a = fetch16(gb);
+        if (!condition(gb, y))
+          return 12;
+        r->pc = a;
+        return 16;
+      }
+      }
+    case 3:
+      switch (y) {
+      case 0: /* JP a16 */
+        r->pc = fetch16(gb);
+        return 16;
+      case 1:
+        return executeCB(gb);
+      case 6: /* DI */
+        gb->cpu.ime = false;
+        gb->cpu.imeDelay = 0;
+        return 4;
+      case 7: /* EI */
+        gb->cpu.imeDelay = 2;
+        return 4;
+      default: /* unused opcodes, real hardware locks up */
+        return 4;
+      }
+    case 4: {
+      if (y >= 4) /* unused */
+        return 4;
+      word a = fetch16(gb); /* CALL cc,a16 */
+      if (!condition(gb, y))
+        return 12;
+      push(gb, r->pc);
+      r->pc = a;
+      return 24;
+    }
+    case 5:
+      if (q == 0) { /* PUSH rr */
+        push(gb, p == 3 ? r->af : *rp(gb, p));
+        return 16;
+      }
+      if (p == 0) { /* CALL a16 */
+        word a = fetch16(gb);
+        push(gb, r->pc);
+        r->pc = a;
+        return 24;
+      }
+      return 4; /* unused */
+    case 6: /* ALU A,d8 */
+      alu(gb, y, fetch(gb));
+      return 8;
+    default: /* RST */
+      push(gb, r->pc);
+      r->pc = (word)(y * 8);
+      return 16;
+    }
+  }
+}
+
+static int serviceInterrupts(GB *gb) {
+  byte *ram = gb->mem->ram;
+  byte pending = ram[GB_IO_IF] & ram[GB_IO_IE] & 0x1F;
+  if (pending == 0)
+    return 0;
+
+  gb->cpu.halted = false;
+  if (!gb->cpu.ime)
+    return 0;
+
+  small bit = 0;
+  while (!testBit(pending, bit))
+    bit++;
+
+  gb->cpu.ime = false;
+  ram[GB_IO_IF] = clearBit(ram[GB_IO_IF], bit);
+  push(gb, gb->cpu.regs.pc);
+  gb->cpu.regs.pc = (word)(0x40 + bit * 8);
+  return 20;
+}
+
+int gbCpuStep(GB *gb) {
+  int cycles = serviceInterrupts(gb);
+  if (cycles != 0)
+    return cycles;
+
+  if (gb->cpu.halted)
+    return 4;
+
+  if (gb->debug != NULL && gbDebugCheckPc(gb->debug, gb->cpu.regs.pc))
+    return 0;
+
+  if (gb->itrace != NULL)
+    gbITraceRecord(gb->itrace, gb);
+
+#ifdef GB_HOTSPOTS
+  word pc = gb->cpu.regs.pc;
+  word opcode = *gbMemRead(gb->mem, pc);
+  if (opcode == 0xCB)
+    opcode = 0x100 | *gbMemRead(gb->mem, (word)(pc + 1));
+#endif
+
+  cycles = execute(gb, fetch(gb));
+
+#ifdef GB_HOTSPOTS
+  if (gb->hotspots != NULL)
+    gbHotspotsRecord(gb->hotspots, gb, pc, opcode, cycles);
+#endif
+
+  if (gb->cpu.imeDelay != 0 && --gb->cpu.imeDelay == 0)
+    gb->cpu.ime = true;
+
+  return cycles;
+}
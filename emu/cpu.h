@@ -45,4 +45,21 @@ typedef struct {
 
   unsigned short sp;
   unsigned short pc;
-} GBRegisters;
\ No newline at end of file
+} GBRegisters;
+
+#define GB_FLAG_Z 0x80
+#define GB_FLAG_N 0x40
+#define GB_FLAG_H 0x20
+#define GB_FLAG_C 0x10
+
+typedef struct {
+  GBRegisters regs;
+  bool ime;
+  byte imeDelay; /* EI enables interrupts after the following instruction */
+  bool halted;
+} GBCpu;
+
+struct GB;
+
+/* Executes one instruction (or interrupt dispatch), returns T-cycles taken */
+int gbCpuStep(struct GB *gb);
@@ -0,0 +1,109 @@
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+GBDebug *gbDebugNew(void) {
+  GBDebug *debug = malloc(sizeof(GBDebug));
+  if (debug == NULL) {
+    gbSetError("<<gbDebugNew>> out of memory");
+    return NULL;
+  }
+  memset(debug, 0, sizeof(GBDebug));
+  return debug;
+}
+
+void gbDebugFree(GBDebug *debug) { free(debug); }
+
+bool gbDebugHasBreakpoint(const GBDebug *debug, addr pc) {
+  return (debug->breakpoints[pc >> 6] >> (pc & 63)) & 1;
+}
+
+void gbDebugSetBreakpoint(GBDebug *debug, addr pc, bool enabled) {
+  if (gbDebugHasBreakpoint(debug, pc) == enabled)
+    return;
+  debug->breakpoints[pc >> 6] ^= (uint64_t)1 << (pc & 63);
+  debug->breakpointCount += enabled ? 1 : -1;
+}
+
+static void markPages(GBDebug *debug) {
+  memset(debug->watchPages, 0, sizeof(debug->watchPages));
+  for (int i = 0; i < debug->watchpointCount; i++) {
+    const GBWatchpoint *w = &debug->watchpoints[i];
+    for (int page = w->start >> 8; page <= w->end >> 8; page++)
+      debug->watchPages[page] |= w->kind;
+  }
+}
+
+int gbDebugAddWatchpoint(GBDebug *debug, addr start, addr end, byte kind) {
+  if (debug->watchpointCount == GB_DEBUG_WATCHPOINTS) {
+    gbSetError("<<gbDebugAddWatchpoint>> at most %d watchpoints",
+               GB_DEBUG_WATCHPOINTS);
+    return 1;
+  }
+  if (end < start || kind == 0) {
+    gbSetError("<<gbDebugAddWatchpoint>> empty watchpoint");
+    return 1;
+  }
+  debug->watchpoints[debug->watchpointCount++] = (GBWatchpoint){start, end,
+                                                                kind};
+  markPages(debug);
+  return 0;
+}
+
+void gbDebugRemoveWatchpoint(GBDebug *debug, int index) {
+  if (index < 0 || index >= debug->watchpointCount)
+    return;
+  memmove(&debug->watchpoints[index], &debug->watchpoints[index + 1],
+          (size_t)(debug->watchpointCount - index - 1) * sizeof(GBWatchpoint));
+  debug->watchpointCount--;
+  markPages(debug);
+}
+
+void gbDebugContinue(GBDebug *debug) {
+  /* a pc or step break stopped before the instruction, so let it run */
+  debug->resuming =
+      debug->reason == GB_BREAK_PC || debug->reason == GB_BREAK_STEP;
+  debug->reason = GB_BREAK_NONE;
+  debug->stepping = false;
+}
+
+void gbDebugStep(GBDebug *debug) {
+  gbDebugContinue(debug);
+  debug->resuming = true;
+  debug->stepping = true;
+}
+
+bool gbDebugCheckPc(GBDebug *debug, addr pc) {
+  if (debug->resuming) {
+    debug->resuming = false;
+    return false;
+  }
+  if (debug->stepping) {
+    debug->stepping = false;
+    debug->reason = GB_BREAK_STEP;
+    debug->address = pc;
+    return true;
+  }
+  if (debug->breakpointCount != 0 && gbDebugHasBreakpoint(debug, pc)) {
+    debug->reason = GB_BREAK_PC;
+    debug->address = pc;
+    return true;
+  }
+  return false;
+}
+
+void gbDebugCheckAccess(GBDebug *debug, addr address, byte value,
+                        GBWatchKind kind) {
+  if (debug->reason != GB_BREAK_NONE)
+    return;
+  for (int i = 0; i < debug->watchpointCount; i++) {
+    const GBWatchpoint *w = &debug->watchpoints[i];
+    if ((w->kind & kind) && address >= w->start && address <= w->end) {
+      debug->reason = kind == GB_WATCH_READ ? GB_BREAK_READ : GB_BREAK_WRITE;
+      debug->address = address;
+      debug->value = value;
+      return;
+    }
+  }
+}
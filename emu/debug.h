@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * PC breakpoints and memory watchpoints. Nothing is checked until a GBDebug
+ * is attached to gb->debug. Breakpoints are a bitmap over the address space;
+ * watchpoints mark their 256 byte pages so gbRead/gbWrite only take the slow
+ * matching path for watched pages. A hit stops gbRunFrame after the
+ * instruction (watchpoints) or before it (breakpoints); gbDebugContinue or
+ * gbDebugStep resumes.
+ */
+
+#define GB_DEBUG_WATCHPOINTS 32
+
+typedef enum {
+  GB_WATCH_READ = 1 << 0,
+  GB_WATCH_WRITE = 1 << 1,
+} GBWatchKind;
+
+typedef enum {
+  GB_BREAK_NONE,
+  GB_BREAK_PC,
+  GB_BREAK_READ,
+  GB_BREAK_WRITE,
+  GB_BREAK_STEP,
+} GBBreakReason;
+
+typedef struct {
+  addr start;
+  addr end; /* inclusive */
+  byte kind; /* GBWatchKind mask */
+} GBWatchpoint;
+
+typedef struct GBDebug {
+  uint64_t breakpoints[0x10000 / 64];
+  int breakpointCount;
+
+  GBWatchpoint watchpoints[GB_DEBUG_WATCHPOINTS];
+  int watchpointCount;
+  byte watchPages[0x100]; /* GBWatchKind mask of every watchpoint touching */
+
+  /* why emulation stopped, GB_BREAK_NONE while running */
+  GBBreakReason reason;
+  addr address; /* pc or accessed address */
+  byte value;   /* byte read or written */
+
+  bool stepping; /* stop before the next instruction */
+  bool resuming; /* the next instruction runs whatever its pc */
+} GBDebug;
+
+GBDebug *gbDebugNew(void);
+void gbDebugFree(GBDebug *debug);
+
+void gbDebugSetBreakpoint(GBDebug *debug, addr pc, bool enabled);
+bool gbDebugHasBreakpoint(const GBDebug *debug, addr pc);
+
+int gbDebugAddWatchpoint(GBDebug *debug, addr start, addr end, byte kind);
+void gbDebugRemoveWatchpoint(GBDebug *debug, int index);
+
+void gbDebugContinue(GBDebug *debug);
+/* Continue for exactly one instruction */
+void gbDebugStep(GBDebug *debug);
+
+/* Hooks for the CPU and bus, only called while gb->debug is set */
+bool gbDebugCheckPc(GBDebug *debug, addr pc); /* true to stop before pc */
+void gbDebugCheckAccess(GBDebug *debug, addr address, byte value,
+                        GBWatchKind kind);
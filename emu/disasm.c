@@ -0,0 +1,385 @@
+#include "disasm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* key layout: [cartridge offsets][0x8000-0xFFFF][boot ROM] */
+#define HIGH_SPAN 0x8000
+#define BOOT_SPAN 0x100
+
+static const char *const R8[8] = {"B", "C", "D", "E", "H", "L", "(HL)", "A"};
+static const char *const RP[4] = {"BC", "DE", "HL", "SP"};
+static const char *const RP2[4] = {"BC", "DE", "HL", "AF"};
+static const char *const CC[4] = {"NZ", "Z", "NC", "C"};
+static const char *const ALU[8] = {"ADD A,", "ADC A,", "SUB ", "SBC A,",
+                                   "AND ",   "XOR ",   "OR ",  "CP "};
+static const char *const ROT[8] = {"RLC", "RRC", "RL",   "RR",
+                                   "SLA", "SRA", "SWAP", "SRL"};
+static const char *const MISC[8] = {"RLCA", "RRCA", "RLA", "RRA",
+                                    "DAA",  "CPL",  "SCF", "CCF"};
+static const char *const LD_IND[4] = {"(BC)", "(DE)", "(HL+)", "(HL-)"};
+
+/* High page registers worth naming in LDH operands */
+static const char *ioName(byte low) {
+  switch (0xFF00 | low) {
+  case GB_IO_P1:
+    return "P1";
+  case GB_IO_DIV:
+    return "DIV";
+  case GB_IO_TIMA:
+    return "TIMA";
+  case GB_IO_TMA:
+    return "TMA";
+  case GB_IO_TAC:
+    return "TAC";
+  case GB_IO_IF:
+    return "IF";
+  case GB_IO_LCDC:
+    return "LCDC";
+  case GB_IO_STAT:
+    return "STAT";
+  case GB_IO_SCY:
+    return "SCY";
+  case GB_IO_SCX:
+    return "SCX";
+  case GB_IO_LY:
+    return "LY";
+  case GB_IO_LYC:
+    return "LYC";
+  case GB_IO_DMA:
+    return "DMA";
+  case GB_IO_BGP:
+    return "BGP";
+  case GB_IO_OBP0:
+    return "OBP0";
+  case GB_IO_OBP1:
+    return "OBP1";
+  case GB_IO_WY:
+    return "WY";
+  case GB_IO_WX:
+    return "WX";
+  case GB_IO_BOOT:
+    return "BOOT";
+  case GB_IO_IE:
+    return "IE";
+  default:
+    return NULL;
+  }
+}
+
+static void high(char buf[8], byte low) {
+  const char *name = ioName(low);
+  if (name != NULL)
+    snprintf(buf, 8, "%s", name);
+  else
+    snprintf(buf, 8, "$FF%02X", low);
+}
+
+static void flow(GBInstruction *out, GBFlow kind, bool conditional) {
+  out->flow = kind;
+  out->conditional = conditional;
+}
+
+static void target(GBInstruction *out, addr to) {
+  out->hasTarget = true;
+  out->target = to;
+}
+
+static void decodeCB(byte op, GBInstruction *out) {
+  small x = op >> 6;
+  small y = (op >> 3) & 7;
+  small z = op & 7;
+  static const char *const BITS[4] = {NULL, "BIT", "RES", "SET"};
+  out->length = 2;
+  if (x == 0)
+    snprintf(out->text, sizeof(out->text), "%s %s", ROT[y], R8[z]);
+  else
+    snprintf(out->text, sizeof(out->text), "%s %d,%s", BITS[x], y, R8[z]);
+}
+
+void gbDecode(const byte bytes[3], addr pc, GBInstruction *out) {
+  byte op = bytes[0];
+  small x = op >> 6;
+  small y = (op >> 3) & 7;
+  small z = op & 7;
+  small p = y >> 1;
+  small q = y & 1;
+  byte d8 = bytes[1];
+  word d16 = (word)(bytes[1] | (bytes[2] << 8));
+  signed char e = (signed char)bytes[1];
+  addr rel = (addr)(pc + 2 + e);
+  char io[8];
+  char *t = out->text;
+  size_t n = sizeof(out->text);
+
+  memset(out, 0, sizeof(GBInstruction));
+  out->length = 1;
+
+  switch (x) {
+  case 0:
+    switch (z) {
+    case 0:
+      if (y == 0) {
+        snprintf(t, n, "NOP");
+      } else if (y == 1) {
+        out->length = 3;
+        snprintf(t, n, "LD ($%04X),SP", d16);
+      } else if (y == 2) {
+        out->length = 2; /* the CPU skips the byte after STOP */
+        snprintf(t, n, "STOP");
+      } else {
+        out->length = 2;
+        flow(out, GB_FLOW_JUMP, y > 3);
+        target(out, rel);
+        if (y == 3)
+          snprintf(t, n, "JR $%04X", rel);
+        else
+          snprintf(t, n, "JR %s,$%04X", CC[y - 4], rel);
+      }
+      break;
+    case 1:
+      if (q == 0) {
+        out->length = 3;
+        snprintf(t, n, "LD %s,$%04X", RP[p], d16);
+      } else {
+        snprintf(t, n, "ADD HL,%s", RP[p]);
+      }
+      break;
+    case 2:
+      if (q == 0)
+        snprintf(t, n, "LD %s,A", LD_IND[p]);
+      else
+        snprintf(t, n, "LD A,%s", LD_IND[p]);
+      break;
+    case 3:
+      snprintf(t, n, "%s %s", q == 0 ? "INC" : "DEC", RP[p]);
+      break;
+    case 4:
+      snprintf(t, n, "INC %s", R8[y]);
+      break;
+    case 5:
+      snprintf(t, n, "DEC %s", R8[y]);
+      break;
+    case 6:
+      out->length = 2;
+      snprintf(t, n, "LD %s,$%02X", R8[y], d8);
+      break;
+    default:
+      snprintf(t, n, "%s", MISC[y]);
+      break;
+    }
+    break;
+  case 1:
+    if (y == 6 && z == 6)
+      snprintf(t, n, "HALT");
+    else
+      snprintf(t, n, "LD %s,%s", R8[y], R8[z]);
+    break;
+  case 2:
+    snprintf(t, n, "%s%s", ALU[y], R8[z]);
+    break;
+  default:
+    switch (z) {
+    case 0:
+      if (y < 4) {
+        flow(out, GB_FLOW_RETURN, true);
+        snprintf(t, n, "RET %s", CC[y]);
+      } else if (y == 4 || y == 6) {
+        out->length = 2;
+        high(io, d8);
+        snprintf(t, n, y == 4 ? "LDH (%s),A" : "LDH A,(%s)", io);
+      } else {
+        out->length = 2;
+        snprintf(t, n, y == 5 ? "ADD SP,%d" : "LD HL,SP%+d", e);
+      }
+      break;
+    case 1:
+      if (q == 0) {
+        snprintf(t, n, "POP %s", RP2[p]);
+      } else if (p == 0 || p == 1) {
+        flow(out, GB_FLOW_RETURN, false);
+        snprintf(t, n, p == 0 ? "RET" : "RETI");
+      } else if (p == 2) {
+        flow(out, GB_FLOW_INDIRECT, false);
+        snprintf(t, n, "JP HL");
+      } else {
+        snprintf(t, n, "LD SP,HL");
+      }
+      break;
+    case 2:
+      if (y < 4) {
+        out->length = 3;
+        flow(out, GB_FLOW_JUMP, true);
+        target(out, d16);
+        snprintf(t, n, "JP %s,$%04X", CC[y], d16);
+      } else if (y == 4 || y == 6) {
+        snprintf(t, n, y == 4 ? "LD (C),A" : "LD A,(C)");
+      } else {
+        out->length = 3;
+        snprintf(t, n, y == 5 ? "LD ($%04X),A" : "LD A,($%04X)", d16);
+      }
+      break;
+    case 3:
+      if (y == 0) {
+        out->length = 3;
+        flow(out, GB_FLOW_JUMP, false);
+        target(out, d16);
+        snprintf(t, n, "JP $%04X", d16);
+      } else if (y == 1) {
+        decodeCB(d8, out);
+      } else if (y == 6 || y == 7) {
+        snprintf(t, n, y == 6 ? "DI" : "EI");
+      } else {
+        snprintf(t, n, "DB $%02X", op);
+      }
+      break;
+    case 4:
+      if (y < 4) {
+        out->length = 3;
+        flow(out, GB_FLOW_CALL, true);
+        target(out, d16);
+        snprintf(t, n, "CALL %s,$%04X", CC[y], d16);
+      } else {
+        snprintf(t, n, "DB $%02X", op);
+      }
+      break;
+    case 5:
+      if (q == 0) {
+        snprintf(t, n, "PUSH %s", RP2[p]);
+      } else if (p == 0) {
+        out->length = 3;
+        flow(out, GB_FLOW_CALL, false);
+        target(out, d16);
+        snprintf(t, n, "CALL $%04X", d16);
+      } else {
+        snprintf(t, n, "DB $%02X", op);
+      }
+      break;
+    case 6:
+      out->length = 2;
+      snprintf(t, n, "%s$%02X", ALU[y], d8);
+      break;
+    default:
+      flow(out, GB_FLOW_CALL, false);
+      target(out, (addr)(y * 8));
+      snprintf(t, n, "RST $%02X", y * 8);
+      break;
+    }
+    break;
+  }
+  memcpy(out->bytes, bytes, out->length);
+}
+
+GBDisasm *gbDisasmNew(const GB *gb) {
+  GBDisasm *disasm = malloc(sizeof(GBDisasm));
+  if (disasm == NULL) {
+    gbSetError("<<gbDisasmNew>> out of memory");
+    return NULL;
+  }
+  const GBMemory *mem = gb->mem;
+  disasm->cartSpan = mem->cart != NULL ? mem->cartSize : 0x8000;
+  size_t keys = disasm->cartSpan + HIGH_SPAN + BOOT_SPAN;
+  disasm->pageCount = (keys + GB_MEM_PAGE_SIZE - 1) / GB_MEM_PAGE_SIZE;
+  disasm->pages = calloc(disasm->pageCount, sizeof(GBInstruction *));
+  disasm->labels = calloc((keys + 63) / 64, sizeof(uint64_t));
+  if (disasm->pages == NULL || disasm->labels == NULL) {
+    gbSetError("<<gbDisasmNew>> cannot index %zu addresses", keys);
+    gbDisasmFree(disasm);
+    return NULL;
+  }
+  return disasm;
+}
+
+void gbDisasmFree(GBDisasm *disasm) {
+  if (disasm->pages != NULL)
+    for (size_t i = 0; i < disasm->pageCount; i++)
+      free(disasm->pages[i]);
+  free(disasm->pages);
+  free(disasm->labels);
+  free(disasm);
+}
+
+static size_t bankOf(const GBMemory *mem, int bank) {
+  return bank < 0 ? mem->mapper.romBank : (size_t)bank;
+}
+
+static size_t keyOf(const GBDisasm *disasm, const GBMemory *mem, int bank,
+                    addr address) {
+  if (address < BOOT_SPAN && mem->bootRom)
+    return disasm->cartSpan + HIGH_SPAN + address;
+  if (address >= 0x8000)
+    return disasm->cartSpan + (address - 0x8000);
+  if (mem->cart == NULL)
+    return address;
+  if (address < GB_MEM_ROM_BANK_SIZE)
+    return address % mem->cartSize;
+  return (bankOf(mem, bank) * GB_MEM_ROM_BANK_SIZE +
+          (address - GB_MEM_ROM_BANK_SIZE)) %
+         mem->cartSize;
+}
+
+static byte fetchAt(const GBDisasm *disasm, const GBMemory *mem,
+                    const byte *view, int bank, addr address) {
+  size_t key = keyOf(disasm, mem, bank, address);
+  if (address < BOOT_SPAN && mem->bootRom)
+    return mem->rom[address];
+  if (address < 0x8000 && mem->cart != NULL)
+    return mem->cart[key];
+  return view[address];
+}
+
+const GBInstruction *gbDisasmAt(GBDisasm *disasm, const GBMemory *mem,
+                                const byte *view, int bank, addr address) {
+  size_t key = keyOf(disasm, mem, bank, address);
+  GBInstruction **page = &disasm->pages[key / GB_MEM_PAGE_SIZE];
+  if (*page == NULL &&
+      (*page = calloc(GB_MEM_PAGE_SIZE, sizeof(GBInstruction))) == NULL) {
+    gbSetError("<<gbDisasmAt>> out of memory");
+    return NULL;
+  }
+
+  byte bytes[3];
+  for (int i = 0; i < 3; i++)
+    bytes[i] = fetchAt(disasm, mem, view, bank, (addr)(address + i));
+
+  GBInstruction *in = &(*page)[key % GB_MEM_PAGE_SIZE];
+  if (in->valid && memcmp(in->bytes, bytes, in->length) == 0)
+    return in;
+
+  gbDecode(bytes, address, in);
+  in->valid = true;
+  if (in->hasTarget) {
+    size_t to = keyOf(disasm, mem, bank, in->target);
+    disasm->labels[to / 64] |= (uint64_t)1 << (to % 64);
+  }
+  return in;
+}
+
+bool gbDisasmLabel(const GBDisasm *disasm, const GBMemory *mem, int bank,
+                   addr address, char buf[16]) {
+  static const char *const Vectors[5] = {"VBLANK", "STAT", "TIMER",
+                                         "SERIAL", "JOYPAD"};
+  bool boot = address < BOOT_SPAN && mem->bootRom;
+  if (!boot && address >= 0x40 && address <= 0x60 && address % 8 == 0) {
+    snprintf(buf, 16, "%s", Vectors[(address - 0x40) / 8]);
+    return true;
+  }
+  if (!boot && address < 0x40 && address % 8 == 0) {
+    snprintf(buf, 16, "RST_%02X", address);
+    return true;
+  }
+  if (!boot && address == 0x100) {
+    snprintf(buf, 16, "ENTRY");
+    return true;
+  }
+
+  size_t key = keyOf(disasm, mem, bank, address);
+  if (!((disasm->labels[key / 64] >> (key % 64)) & 1))
+    return false;
+  if (address >= GB_MEM_ROM_BANK_SIZE && address < 0x8000)
+    snprintf(buf, 16, "L%02zX_%04X", bankOf(mem, bank), address);
+  else
+    snprintf(buf, 16, "L_%04X", address);
+  return true;
+}
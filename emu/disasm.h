@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * SM83 disassembler. gbDecode splits opcodes into the same octal fields and
+ * operand orderings cpu.c executes them by. GBDisasm caches decoded
+ * instructions per (ROM bank, address), keyed like the hotspot profiler:
+ * cartridge offset below 0x8000, address above, boot ROM apart. Pages of the
+ * cache are allocated on first use. Every lookup compares the entry against
+ * the bytes it was decoded from, so code rewritten in RAM is decoded again
+ * while ROM is only ever decoded once. Jump and call targets seen while
+ * decoding become labels.
+ */
+
+typedef enum {
+  GB_FLOW_NEXT,
+  GB_FLOW_JUMP,     /* JP, JR */
+  GB_FLOW_CALL,     /* CALL, RST */
+  GB_FLOW_RETURN,   /* RET, RETI */
+  GB_FLOW_INDIRECT, /* JP HL */
+} GBFlow;
+
+typedef struct {
+  char text[20];
+  byte bytes[3];
+  byte length;
+  byte flow; /* GBFlow */
+  bool conditional;
+  bool hasTarget;
+  bool valid; /* cache entries only */
+  addr target;
+} GBInstruction;
+
+/* bytes holds the instruction at pc and whatever follows, up to 3 bytes */
+void gbDecode(const byte bytes[3], addr pc, GBInstruction *out);
+
+typedef struct {
+  GBInstruction **pages; /* GB_MEM_PAGE_SIZE entries each, NULL until used */
+  size_t pageCount;
+  uint64_t *labels; /* one bit per key */
+  size_t cartSpan;  /* keys that are cartridge offsets */
+} GBDisasm;
+
+/* Sized for the cartridge currently loaded in gb */
+GBDisasm *gbDisasmNew(const GB *gb);
+void gbDisasmFree(GBDisasm *disasm);
+
+/*
+ * The instruction at address with bank mapped at 0x4000-0x7FFF, -1 for the
+ * bank mapped now. ROM bytes come from the cartridge, everything else from
+ * view, a 64K bus image such as a GBMemSnapshot view. NULL when out of memory.
+ */
+const GBInstruction *gbDisasmAt(GBDisasm *disasm, const GBMemory *mem,
+                                const byte *view, int bank, addr address);
+
+/* Name of a vector or decoded target at address, false when it has none */
+bool gbDisasmLabel(const GBDisasm *disasm, const GBMemory *mem, int bank,
+                   addr address, char buf[16]);
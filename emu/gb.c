@@ -0,0 +1,229 @@
+#include "gb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blip.h"
+#include "debug.h"
+#include "hotspot.h"
+#include "itrace.h"
+
+#define TRACE_LINES 16
+
+GB *gbNew(void) {
+  GB *gb = malloc(sizeof(GB));
+  if (gb == NULL) {
+    gbSetError("<<gbNew>> out of memory");
+    return NULL;
+  }
+  memset(gb, 0, sizeof(GB));
+
+  gb->mem = gbMemNew();
+  if (gb->mem == NULL) {
+    free(gb);
+    return NULL;
+  }
+  gb->mem->ram[GB_IO_P1] = 0xCF;
+  gb->mem->ram[GB_IO_IF] = 0xE0;
+  gbApuReset(gb);
+  return gb;
+}
+
+void gbFree(GB *gb) {
+  if (gb->itrace != NULL)
+    gbITraceFree(gb->itrace);
+  if (gb->debug != NULL)
+    gbDebugFree(gb->debug);
+#ifdef GB_HOTSPOTS
+  if (gb->hotspots != NULL)
+    gbHotspotsFree(gb->hotspots);
+#endif
+  gbMemFree(gb->mem);
+  free(gb);
+}
+
+int gbLoadRom(GB *gb, const byte *data, size_t size) {
+  return gbMemLoadCart(gb->mem, data, size);
+}
+
+int gbLoadRomFile(GB *gb, const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    gbSetError("<<gbLoadRomFile>> cannot open %s", path);
+    return 1;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  byte *data = size > 0 ? malloc((size_t)size) : NULL;
+  if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+    gbSetError("<<gbLoadRomFile>> cannot read %s", path);
+    free(data);
+    fclose(f);
+    return 1;
+  }
+  fclose(f);
+
+  int err = gbLoadRom(gb, data, (size_t)size);
+  free(data);
+  return err;
+}
+
+static void updateJoypad(GB *gb) {
+  byte p1 = gb->mem->ram[GB_IO_P1];
+  byte pressed = 0;
+  if (!testBit(p1, 4))
+    pressed |= gb->buttons & 0x0F; /* right, left, up, down */
+  if (!testBit(p1, 5))
+    pressed |= gb->buttons >> 4; /* a, b, select, start */
+  gb->mem->ram[GB_IO_P1] = 0xC0 | (p1 & 0x30) | (~pressed & 0x0F);
+}
+
+void gbSetButtons(GB *gb, byte buttons) {
+  if (buttons & ~gb->buttons)
+    gbRequestInterrupt(gb, GB_INT_JOYPAD);
+  gb->buttons = buttons;
+  updateJoypad(gb);
+}
+
+void gbRequestInterrupt(GB *gb, byte interrupt) {
+  gb->mem->ram[GB_IO_IF] |= interrupt;
+}
+
+/* Only pages holding a watchpoint leave the fast path */
+static bool watched(const GB *gb, addr address, GBWatchKind kind) {
+  return gb->debug != NULL && (gb->debug->watchPages[address >> 8] & kind);
+}
+
+byte gbRead(GB *gb, addr address) {
+  /* DIV, TIMA and the channel status bits change lazily. LY and STAT only
+   * change on mode boundaries, which gbStep syncs as events */
+  if (address == GB_IO_DIV || address == GB_IO_TIMA)
+    gbTimerSync(gb);
+  else if (address == GB_IO_NR52)
+    gbApuSync(gb);
+  byte value = *gbMemRead(gb->mem, address);
+  if (watched(gb, address, GB_WATCH_READ))
+    gbDebugCheckAccess(gb->debug, address, value, GB_WATCH_READ);
+  return value;
+}
+
+static void busWrite(GB *gb, addr address, byte value) {
+  byte *ram = gb->mem->ram;
+
+  if (address < 0xFF00 || address >= 0xFF80) {
+    gbMemWrite(gb->mem, address, value);
+    return;
+  }
+  if (address >= GB_IO_NR10 && address < GB_IO_WAVE + 0x10) {
+    gbApuWrite(gb, address, value);
+    return;
+  }
+
+  switch (address) {
+  case GB_IO_P1:
+    ram[GB_IO_P1] = (ram[GB_IO_P1] & 0xCF) | (value & 0x30);
+    updateJoypad(gb);
+    break;
+  case GB_IO_DIV:
+  case GB_IO_TIMA:
+  case GB_IO_TMA:
+  case GB_IO_TAC:
+    gbTimerWrite(gb, address, value);
+    break;
+  case GB_IO_IF:
+    ram[GB_IO_IF] = 0xE0 | value;
+    break;
+  case GB_IO_LCDC:
+  case GB_IO_STAT:
+  case GB_IO_LYC:
+    gbPpuWrite(gb, address, value);
+    break;
+  case GB_IO_LY:
+    break;
+  case GB_IO_DMA:
+    ram[GB_IO_DMA] = value;
+    for (int i = 0; i < 0xA0; i++)
+      ram[0xFE00 + i] = gbRead(gb, (addr)((value << 8) | i));
+    gbMemMarkDirty(gb->mem, 0xFE00);
+    break;
+  case GB_IO_BOOT:
+    if (value != 0)
+      gb->mem->bootRom = false;
+    ram[GB_IO_BOOT] = value;
+    break;
+  default:
+    gbMemWrite(gb->mem, address, value);
+    break;
+  }
+}
+
+void gbWrite(GB *gb, addr address, byte value) {
+  GB_PROFILE_BEGIN(GB_PROFILE_MEM);
+  if (watched(gb, address, GB_WATCH_WRITE))
+    gbDebugCheckAccess(gb->debug, address, value, GB_WATCH_WRITE);
+  busWrite(gb, address, value);
+  GB_PROFILE_END();
+}
+
+int gbStep(GB *gb) {
+  GB_PROFILE_BEGIN(GB_PROFILE_CPU);
+  int cycles = gbCpuStep(gb);
+  GB_PROFILE_END();
+  gb->cycles += cycles;
+  /* Only the interrupt sources are scheduled, registers are read lazily */
+  if (gb->cycles >= gb->timer.next) {
+    GB_PROFILE_BEGIN(GB_PROFILE_TIMER);
+    gbTimerSync(gb);
+    GB_PROFILE_END();
+  }
+  if (gb->cycles >= gb->ppu.next) {
+    GB_PROFILE_BEGIN(GB_PROFILE_PPU);
+    gbPpuSync(gb);
+    GB_PROFILE_END();
+  }
+  return cycles;
+}
+
+/* Brings the lazy registers up to date so snapshots, save states and the
+ * debugger, which read RAM directly, see them as the CPU would */
+static void endFrame(GB *gb) {
+  gbTimerSync(gb);
+  gbApuEndFrame(gb);
+}
+
+void gbRunFrame(GB *gb) { gbRunFrameWith(gb, NULL, NULL); }
+
+void gbRunFrameWith(GB *gb, GBStepHook hook, void *user) {
+  GB_TRACE_BEGIN("gbRunFrame");
+  /* Frame boundaries are fixed points on the cycle counter, so the overshoot
+   * of the last instruction is carried into the next frame */
+  uint64_t end = (gb->frame + 1) * GB_FRAME_CYCLES;
+  while (gb->cycles < end) {
+    /* batches only exist to give the trace timeline some structure */
+    uint64_t batch = gb->cycles + TRACE_LINES * GB_LINE_CYCLES;
+    if (batch > end)
+      batch = end;
+    GB_TRACE_BEGIN("scanlines");
+    while (gb->cycles < batch) {
+      if (hook != NULL)
+        hook(gb, user);
+      gbStep(gb);
+      if (gb->debug != NULL && gb->debug->reason != GB_BREAK_NONE) {
+        endFrame(gb);
+        GB_TRACE_END("scanlines");
+        GB_TRACE_END("gbRunFrame");
+        return;
+      }
+    }
+    GB_TRACE_END("scanlines");
+  }
+  endFrame(gb);
+  gb->frame++;
+  GB_TRACE_END("gbRunFrame");
+}
+
+const byte *gbGetFramebuffer(const GB *gb) { return gb->ppu.framebuffer; }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "apu.h"
+#include "common.h"
+#include "cpu.h"
+#include "mem.h"
+#include "ppu.h"
+#include "timer.h"
+
+#define GB_IO_P1 0xFF00
+#define GB_IO_DIV 0xFF04
+#define GB_IO_TIMA 0xFF05
+#define GB_IO_TMA 0xFF06
+#define GB_IO_TAC 0xFF07
+#define GB_IO_IF 0xFF0F
+#define GB_IO_NR10 0xFF10
+#define GB_IO_NR11 0xFF11
+#define GB_IO_NR12 0xFF12
+#define GB_IO_NR13 0xFF13
+#define GB_IO_NR14 0xFF14
+#define GB_IO_NR30 0xFF1A
+#define GB_IO_NR32 0xFF1C
+#define GB_IO_NR43 0xFF22
+#define GB_IO_NR50 0xFF24
+#define GB_IO_NR51 0xFF25
+#define GB_IO_NR52 0xFF26
+#define GB_IO_WAVE 0xFF30 /* 16 bytes of 4-bit samples, to 0xFF3F */
+#define GB_IO_LCDC 0xFF40
+#define GB_IO_STAT 0xFF41
+#define GB_IO_SCY 0xFF42
+#define GB_IO_SCX 0xFF43
+#define GB_IO_LY 0xFF44
+#define GB_IO_LYC 0xFF45
+#define GB_IO_DMA 0xFF46
+#define GB_IO_BGP 0xFF47
+#define GB_IO_OBP0 0xFF48
+#define GB_IO_OBP1 0xFF49
+#define GB_IO_WY 0xFF4A
+#define GB_IO_WX 0xFF4B
+#define GB_IO_BOOT 0xFF50
+#define GB_IO_IE 0xFFFF
+
+#define GB_CLOCK_RATE 4194304 /* T-cycles per second */
+
+#define GB_INT_VBLANK 0x01
+#define GB_INT_STAT 0x02
+#define GB_INT_TIMER 0x04
+#define GB_INT_SERIAL 0x08
+#define GB_INT_JOYPAD 0x10
+
+/*
+ * A single emulated Game Boy. All mutable emulator state hangs off this handle
+ * and nothing in emu/ or common/ keeps globals, so independent instances can be
+ * driven from separate threads.
+ */
+typedef struct GB {
+  GBCpu cpu;
+  GBMemory *mem;
+  GBTimer timer;
+  GBPpu ppu;
+  GBApu apu;
+  byte buttons;    /* GBButton mask of the buttons held down */
+  uint64_t cycles; /* T-cycles executed since power on */
+  uint64_t frame;  /* frames completed by gbRunFrame */
+  struct GBITrace *itrace; /* see itrace.h, NULL when not tracing */
+  struct GBDebug *debug;   /* see debug.h, NULL when not debugging */
+  struct GBBlip *blip;     /* see blip.h, NULL when not producing audio */
+#ifdef GB_HOTSPOTS
+  struct GBHotspots *hotspots; /* see hotspot.h, NULL when not counting */
+#endif
+} GB;
+
+GB *gbNew(void);
+void gbFree(GB *gb);
+
+int gbLoadRom(GB *gb, const byte *data, size_t size);
+int gbLoadRomFile(GB *gb, const char *path);
+
+void gbSetButtons(GB *gb, byte buttons);
+
+int gbStep(GB *gb);
+/* Returns early, without completing the frame, when a GBDebug break hits */
+void gbRunFrame(GB *gb);
+/* Called before every instruction gbRunFrameWith executes */
+typedef void (*GBStepHook)(GB *gb, void *user);
+/* gbRunFrame for front ends that inject input or count instructions */
+void gbRunFrameWith(GB *gb, GBStepHook hook, void *user);
+
+const byte *gbGetFramebuffer(const GB *gb);
+
+byte gbRead(GB *gb, addr address);
+void gbWrite(GB *gb, addr address, byte value);
+void gbRequestInterrupt(GB *gb, byte interrupt);
@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+ * Public interface of the gbcore library. Embedders include this header only;
+ * the functions it exposes keep their signatures within a major version.
+ */
+
+#define GB_CORE_VERSION_MAJOR 0
+#define GB_CORE_VERSION_MINOR 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "apu.h"
+#include "batch.h"
+#include "blip.h"
+#include "debug.h"
+#include "disasm.h"
+#include "gb.h"
+#include "hotspot.h"
+#include "itrace.h"
+#include "movie.h"
+#include "rewind.h"
+#include "runahead.h"
+#include "search.h"
+#include "snapshot.h"
+#include "state.h"
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,202 @@
+#include "hotspot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef GB_HOTSPOTS
+
+/* pcs layout: [cartridge offsets][0x8000-0xFFFF][boot ROM] */
+#define HIGH_SPAN 0x8000
+#define BOOT_SPAN 0x100
+
+GBHotspots *gbHotspotsNew(const GB *gb) {
+  GBHotspots *hotspots = malloc(sizeof(GBHotspots));
+  if (hotspots == NULL) {
+    gbSetError("<<gbHotspotsNew>> out of memory");
+    return NULL;
+  }
+  memset(hotspots, 0, sizeof(GBHotspots));
+
+  const GBMemory *mem = gb->mem;
+  hotspots->cartSpan = mem->cart != NULL ? mem->cartSize : 0x8000;
+  hotspots->pcCount = hotspots->cartSpan + HIGH_SPAN + BOOT_SPAN;
+  hotspots->pcs = calloc(hotspots->pcCount, sizeof(GBHotspotLocation));
+  if (hotspots->pcs == NULL) {
+    gbSetError("<<gbHotspotsNew>> cannot allocate %zu counters",
+               hotspots->pcCount);
+    free(hotspots);
+    return NULL;
+  }
+  return hotspots;
+}
+
+void gbHotspotsFree(GBHotspots *hotspots) {
+  free(hotspots->pcs);
+  free(hotspots);
+}
+
+void gbHotspotsReset(GBHotspots *hotspots) {
+  memset(hotspots->opcodes, 0, sizeof(hotspots->opcodes));
+  memset(hotspots->pcs, 0, hotspots->pcCount * sizeof(GBHotspotLocation));
+}
+
+static size_t pcIndex(const GBHotspots *hotspots, const GB *gb, word pc) {
+  const GBMemory *mem = gb->mem;
+  if (pc < BOOT_SPAN && mem->bootRom)
+    return hotspots->cartSpan + HIGH_SPAN + pc;
+  if (pc >= 0x8000)
+    return hotspots->cartSpan + (pc - 0x8000);
+  if (mem->cart == NULL)
+    return pc;
+  if (pc < GB_MEM_ROM_BANK_SIZE)
+    return pc % mem->cartSize;
+  return ((size_t)mem->mapper.romBank * GB_MEM_ROM_BANK_SIZE +
+          (pc - GB_MEM_ROM_BANK_SIZE)) %
+         mem->cartSize;
+}
+
+void gbHotspotsRecord(GBHotspots *hotspots, const GB *gb, word pc,
+                      word opcode, int cycles) {
+  GBHotspotCounter *op = &hotspots->opcodes[opcode];
+  op->count++;
+  op->cycles += (uint64_t)cycles;
+
+  size_t index = pcIndex(hotspots, gb, pc);
+  if (index < hotspots->pcCount) {
+    GBHotspotLocation *location = &hotspots->pcs[index];
+    location->counter.count++;
+    location->counter.cycles += (uint64_t)cycles;
+    location->opcode = opcode;
+  }
+}
+
+/* Room for the widest unsigned the formats below can be handed */
+#define LOCATION_SIZE 24
+#define OPCODE_SIZE 8
+
+/* "bank:addr" as a debugger would show it */
+static void formatLocation(const GBHotspots *hotspots, size_t index,
+                           char buf[LOCATION_SIZE]) {
+  if (index >= hotspots->cartSpan + HIGH_SPAN) {
+    snprintf(buf, LOCATION_SIZE, "boot:%04X",
+             (unsigned)(index - hotspots->cartSpan - HIGH_SPAN));
+  } else if (index >= hotspots->cartSpan) {
+    snprintf(buf, LOCATION_SIZE, "%04X",
+             (unsigned)(index - hotspots->cartSpan + 0x8000));
+  } else {
+    unsigned bank = (unsigned)(index / GB_MEM_ROM_BANK_SIZE);
+    unsigned address = (unsigned)(index % GB_MEM_ROM_BANK_SIZE);
+    snprintf(buf, LOCATION_SIZE, "%02X:%04X", bank,
+             bank == 0 ? address : address + GB_MEM_ROM_BANK_SIZE);
+  }
+}
+
+static void formatOpcode(size_t opcode, char buf[OPCODE_SIZE]) {
+  if (opcode >= 0x100)
+    snprintf(buf, OPCODE_SIZE, "CB %02X", (byte)(opcode - 0x100));
+  else
+    snprintf(buf, OPCODE_SIZE, "%02X", (byte)opcode);
+}
+
+typedef struct {
+  size_t index;
+  uint64_t cycles;
+} Entry;
+
+static int byCycles(const void *a, const void *b) {
+  uint64_t x = ((const Entry *)a)->cycles;
+  uint64_t y = ((const Entry *)b)->cycles;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* Executed entries sorted hottest first, NULL on allocation failure */
+static Entry *sorted(const void *counters, size_t stride, size_t count,
+                     size_t *used) {
+  Entry *entries = malloc((count ? count : 1) * sizeof(Entry));
+  *used = 0;
+  if (entries == NULL)
+    return NULL;
+  for (size_t i = 0; i < count; i++) {
+    /* a GBHotspotLocation starts with its counter */
+    const GBHotspotCounter *counter =
+        (const void *)((const byte *)counters + i * stride);
+    if (counter->count != 0)
+      entries[(*used)++] = (Entry){i, counter->cycles};
+  }
+  qsort(entries, *used, sizeof(Entry), byCycles);
+  return entries;
+}
+
+int gbHotspotsWriteReport(const GBHotspots *hotspots, const char *path,
+                          size_t limit) {
+  size_t opCount, pcCount;
+  Entry *ops = sorted(hotspots->opcodes, sizeof(GBHotspotCounter),
+                      GB_HOTSPOT_OPCODES, &opCount);
+  Entry *pcs = sorted(hotspots->pcs, sizeof(GBHotspotLocation),
+                      hotspots->pcCount, &pcCount);
+  FILE *f = fopen(path, "w");
+  if (ops == NULL || pcs == NULL || f == NULL) {
+    gbSetError("<<gbHotspotsWriteReport>> cannot write %s", path);
+    free(ops);
+    free(pcs);
+    if (f != NULL)
+      fclose(f);
+    return 1;
+  }
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < opCount; i++)
+    total += ops[i].cycles;
+
+  fprintf(f, "%-8s %14s %14s %7s\n", "opcode", "executed", "cycles", "share");
+  for (size_t i = 0; i < opCount; i++) {
+    char name[OPCODE_SIZE];
+    formatOpcode(ops[i].index, name);
+    fprintf(f, "%-8s %14llu %14llu %6.2f%%\n", name,
+            (unsigned long long)hotspots->opcodes[ops[i].index].count,
+            (unsigned long long)ops[i].cycles,
+            total ? 100.0 * ops[i].cycles / total : 0);
+  }
+
+  fprintf(f, "\n%-10s %-8s %14s %14s %7s\n", "location", "opcode",
+          "executed", "cycles", "share");
+  for (size_t i = 0; i < pcCount && i < limit; i++) {
+    const GBHotspotLocation *pc = &hotspots->pcs[pcs[i].index];
+    char location[LOCATION_SIZE], name[OPCODE_SIZE];
+    formatLocation(hotspots, pcs[i].index, location);
+    formatOpcode(pc->opcode, name);
+    fprintf(f, "%-10s %-8s %14llu %14llu %6.2f%%\n", location, name,
+            (unsigned long long)pc->counter.count,
+            (unsigned long long)pc->counter.cycles,
+            total ? 100.0 * pc->counter.cycles / total : 0);
+  }
+
+  free(ops);
+  free(pcs);
+  fclose(f);
+  return 0;
+}
+
+int gbHotspotsWriteFolded(const GBHotspots *hotspots, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    gbSetError("<<gbHotspotsWriteFolded>> cannot open %s", path);
+    return 1;
+  }
+
+  for (size_t i = 0; i < hotspots->pcCount; i++) {
+    const GBHotspotLocation *pc = &hotspots->pcs[i];
+    if (pc->counter.count == 0)
+      continue;
+    char location[LOCATION_SIZE], name[OPCODE_SIZE];
+    formatLocation(hotspots, i, location);
+    formatOpcode(pc->opcode, name);
+    fprintf(f, "%s;%s %llu\n", name, location,
+            (unsigned long long)pc->counter.cycles);
+  }
+  fclose(f);
+  return 0;
+}
+
+#endif
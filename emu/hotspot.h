@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * Guest code hotspots: executed instruction and T-cycle counts per opcode
+ * (CB-prefixed ones separately) and per (ROM bank, PC). Only compiled in with
+ * -DGB_HOTSPOTS=ON; counting starts once a table is attached to gb->hotspots.
+ * PCs in 0x0000-0x7FFF are keyed by their cartridge offset so switchable banks
+ * are told apart; the boot ROM and everything above 0x8000 by address.
+ */
+
+#define GB_HOTSPOT_OPCODES 0x200 /* 0x100-0x1FF are CB-prefixed */
+
+typedef struct {
+  uint64_t count;
+  uint64_t cycles;
+} GBHotspotCounter;
+
+typedef struct {
+  GBHotspotCounter counter;
+  word opcode; /* last one executed here */
+} GBHotspotLocation;
+
+typedef struct GBHotspots {
+  GBHotspotCounter opcodes[GB_HOTSPOT_OPCODES];
+  GBHotspotLocation *pcs;
+  size_t cartSpan; /* pcs entries keyed by cartridge offset */
+  size_t pcCount;
+} GBHotspots;
+
+/* Sized for the cartridge currently loaded in gb */
+GBHotspots *gbHotspotsNew(const GB *gb);
+void gbHotspotsFree(GBHotspots *hotspots);
+void gbHotspotsReset(GBHotspots *hotspots);
+
+void gbHotspotsRecord(GBHotspots *hotspots, const GB *gb, word pc,
+                      word opcode, int cycles);
+
+/* Opcodes and the `limit` hottest locations, sorted by cycles */
+int gbHotspotsWriteReport(const GBHotspots *hotspots, const char *path,
+                          size_t limit);
+/* "opcode;location cycles" lines for flame graph tools */
+int gbHotspotsWriteFolded(const GBHotspots *hotspots, const char *path);
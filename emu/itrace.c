@@ -0,0 +1,88 @@
+#include "itrace.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(GBITraceRecord) == 32, "trace records are 32 bytes");
+_Static_assert(sizeof(GBITraceHeader) == 64, "trace header is 64 bytes");
+
+/* Most records a mapping can hold without its size overflowing */
+#define MAX_CAPACITY                                                           \
+  ((SIZE_MAX - sizeof(GBITraceHeader)) / sizeof(GBITraceRecord))
+
+GBITrace *gbITraceNew(const char *path, size_t capacity) {
+  size_t size = 1;
+  while (size < capacity && size <= MAX_CAPACITY / 2)
+    size <<= 1;
+  if (size < capacity) {
+    gbSetError("<<gbITraceNew>> capacity %zu is too large", capacity);
+    return NULL;
+  }
+
+  GBITrace *trace = malloc(sizeof(GBITrace));
+  if (trace == NULL) {
+    gbSetError("<<gbITraceNew>> out of memory");
+    return NULL;
+  }
+  trace->mask = size - 1;
+  trace->mapSize = sizeof(GBITraceHeader) + size * sizeof(GBITraceRecord);
+
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    gbSetError("<<gbITraceNew>> cannot open %s", path);
+    free(trace);
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)trace->mapSize) != 0) {
+    gbSetError("<<gbITraceNew>> cannot resize %s", path);
+    close(fd);
+    free(trace);
+    return NULL;
+  }
+  void *map =
+      mmap(NULL, trace->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    gbSetError("<<gbITraceNew>> cannot map %s", path);
+    free(trace);
+    return NULL;
+  }
+
+  trace->header = map;
+  trace->records = (GBITraceRecord *)(trace->header + 1);
+  trace->header->magic = GB_ITRACE_MAGIC;
+  trace->header->version = GB_ITRACE_VERSION;
+  trace->header->recordSize = sizeof(GBITraceRecord);
+  trace->header->capacity = size;
+  trace->header->written = 0;
+  return trace;
+}
+
+void gbITraceFree(GBITrace *trace) {
+  munmap(trace->header, trace->mapSize);
+  free(trace);
+}
+
+void gbITraceRecord(GBITrace *trace, GB *gb) {
+  const GBRegisters *regs = &gb->cpu.regs;
+  GBITraceRecord *r = &trace->records[trace->header->written & trace->mask];
+
+  r->cycle = gb->cycles;
+  r->pc = regs->pc;
+  r->bank = regs->pc >= GB_MEM_ROM_BANK_SIZE && regs->pc < 0x8000
+                ? gb->mem->mapper.romBank
+                : 0;
+  r->af = regs->af;
+  r->bc = regs->bc;
+  r->de = regs->de;
+  r->hl = regs->hl;
+  r->sp = regs->sp;
+  for (int i = 0; i < 4; i++)
+    r->pcmem[i] = *gbMemRead(gb->mem, (word)(regs->pc + i));
+
+  trace->header->written++;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * Instruction trace: the CPU state before every executed instruction, kept in
+ * a ring of fixed-size records. The ring is a shared mapping of a file, so the
+ * last `capacity` instructions survive even if the host process dies, and
+ * gb_itrace decodes the file offline. Attach with gb->itrace; recording costs
+ * a 32 byte store per instruction.
+ *
+ *   header (64 bytes): "GBIT" | u32 version | u32 record size | u32 0
+ *                      | u64 capacity | u64 records written | padding
+ *   records:           oldest at (written - capacity) % capacity
+ */
+
+#define GB_ITRACE_MAGIC 0x54494247 /* "GBIT" */
+#define GB_ITRACE_VERSION 1
+
+typedef struct {
+  uint64_t cycle;
+  word pc;
+  word bank; /* ROM bank mapped at 0x4000-0x7FFF when pc is there, else 0 */
+  word af, bc, de, hl, sp;
+  byte pcmem[4]; /* bytes at pc */
+  byte reserved[2];
+} GBITraceRecord;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t reserved;
+  uint64_t capacity;
+  uint64_t written;
+  byte padding[32];
+} GBITraceHeader;
+
+typedef struct GBITrace {
+  GBITraceHeader *header; /* start of the mapping */
+  GBITraceRecord *records;
+  uint64_t mask;
+  size_t mapSize;
+} GBITrace;
+
+/* capacity is rounded up to a power of two */
+GBITrace *gbITraceNew(const char *path, size_t capacity);
+void gbITraceFree(GBITrace *trace);
+
+void gbITraceRecord(GBITrace *trace, GB *gb);
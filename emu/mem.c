@@ -1,7 +1,11 @@
 #include "mem.h"
 
+#include <fcntl.h>
 #include <memory.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 const char gbBootRom[0x100] = {
     0x31, 0xFE, 0xFF, 0xAF, 0x21, 0xFF, 0x9F, 0x32, 0xCB, 0x7C, 0x20, 0xFB,
@@ -28,37 +32,306 @@ const char gbBootRom[0x100] = {
     0x3E, 0x01, 0xE0, 0x50,
 };
 
-GBMemory *gbMemNew() {
+GBMemory *gbMemNew(void) {
   GBMemory *mem = malloc(sizeof(GBMemory));
+  if (mem == NULL) {
+    gbSetError("<<gbMemNew>> out of memory");
+    return NULL;
+  }
   mem->rom = malloc(GB_MEM_ROM_SIZE);
   mem->ram = malloc(GB_MEM_RAM_SIZE);
+  if (mem->rom == NULL || mem->ram == NULL) {
+    gbSetError("<<gbMemNew>> out of memory");
+    free(mem->rom);
+    free(mem->ram);
+    free(mem);
+    return NULL;
+  }
   memset(mem->rom, 0, GB_MEM_ROM_SIZE);
   memset(mem->ram, 0, GB_MEM_RAM_SIZE);
   memcpy(mem->rom, &gbBootRom, GB_MEM_ROM_SIZE);
+  mem->cart = NULL;
+  mem->cartSize = 0;
+  mem->sram = NULL;
+  mem->sramSize = 0;
+  mem->battery = false;
+  mem->sramMapped = false;
+  mem->sramDirty = false;
+  memset(&mem->mapper, 0, sizeof(GBMapper));
+  mem->mapper.romBank = 1;
+  mem->bootRom = true;
+  gbMemMarkAllDirty(mem);
   return mem;
 }
 
+static void releaseSram(GBMemory *mem) {
+  if (mem->sramMapped)
+    munmap(mem->sram, mem->sramSize);
+  else
+    free(mem->sram);
+  mem->sram = NULL;
+  mem->sramSize = 0;
+  mem->sramMapped = false;
+  mem->sramDirty = false;
+}
+
 void gbMemFree(GBMemory *mem) {
+  releaseSram(mem);
   free(mem->rom);
   free(mem->ram);
+  free(mem->cart);
   free(mem);
 }
 
+int gbMemLoadCart(GBMemory *mem, const byte *data, size_t size) {
+  if (size < 0x150) {
+    gbSetError("<<gbMemLoadCart>> image too small (%zu bytes)", size);
+    return 1;
+  }
+
+  static const size_t SramSizes[6] = {0, 0x800, 0x2000, 0x8000, 0x20000,
+                                      0x10000};
+  size_t sramSize = data[0x149] < 6 ? SramSizes[data[0x149]] : 0;
+
+  GBMapperType type;
+  switch (data[0x147]) {
+  case 0x00:
+  case 0x08:
+  case 0x09:
+    type = GB_MAPPER_NONE;
+    break;
+  case 0x01:
+  case 0x02:
+  case 0x03:
+    type = GB_MAPPER_MBC1;
+    break;
+  case 0x0F:
+  case 0x10:
+  case 0x11:
+  case 0x12:
+  case 0x13:
+    type = GB_MAPPER_MBC3;
+    break;
+  case 0x19:
+  case 0x1A:
+  case 0x1B:
+  case 0x1C:
+  case 0x1D:
+  case 0x1E:
+    type = GB_MAPPER_MBC5;
+    break;
+  default:
+    gbSetError("<<gbMemLoadCart>> unsupported cartridge type 0x%02X",
+               data[0x147]);
+    return 1;
+  }
+
+  byte *cart = malloc(size);
+  byte *sram = sramSize > 0 ? calloc(sramSize, 1) : NULL;
+  if (cart == NULL || (sramSize > 0 && sram == NULL)) {
+    gbSetError("<<gbMemLoadCart>> out of memory");
+    free(cart);
+    free(sram);
+    return 1;
+  }
+  memcpy(cart, data, size);
+
+  free(mem->cart);
+  mem->cart = cart;
+  mem->cartSize = size;
+  releaseSram(mem);
+  mem->sram = sram;
+  mem->sramSize = sramSize;
+  switch (data[0x147]) {
+  case 0x03:
+  case 0x09:
+  case 0x0F:
+  case 0x10:
+  case 0x13:
+  case 0x1B:
+  case 0x1E:
+    mem->battery = sramSize > 0;
+    break;
+  default:
+    mem->battery = false;
+    break;
+  }
+  memset(&mem->mapper, 0, sizeof(GBMapper));
+  mem->mapper.type = type;
+  mem->mapper.romBank = 1;
+  return 0;
+}
+
+int gbMemMapBattery(GBMemory *mem, const char *path) {
+  if (!mem->battery) {
+    gbSetError("<<gbMemMapBattery>> cartridge has no battery-backed RAM");
+    return 1;
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    gbSetError("<<gbMemMapBattery>> cannot open %s", path);
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  /* Longer files are fine, e.g. with an RTC footer from other emulators */
+  if ((size_t)st.st_size < mem->sramSize &&
+      ftruncate(fd, (off_t)mem->sramSize) != 0) {
+    gbSetError("<<gbMemMapBattery>> cannot resize %s", path);
+    close(fd);
+    return 1;
+  }
+  byte *map =
+      mmap(NULL, mem->sramSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    gbSetError("<<gbMemMapBattery>> cannot map %s", path);
+    return 1;
+  }
+
+  size_t size = mem->sramSize;
+  releaseSram(mem);
+  mem->sram = map;
+  mem->sramSize = size;
+  mem->sramMapped = true;
+  return 0;
+}
+
+int gbMemSyncBattery(GBMemory *mem, bool wait) {
+  if (!mem->sramMapped || !mem->sramDirty)
+    return 0;
+  mem->sramDirty = false;
+  if (msync(mem->sram, mem->sramSize, wait ? MS_SYNC : MS_ASYNC) != 0) {
+    gbSetError("<<gbMemSyncBattery>> msync failed");
+    return 1;
+  }
+  return 0;
+}
+
+static void mapperWrite(GBMapper *mapper, addr address, byte value) {
+  switch (mapper->type) {
+  case GB_MAPPER_NONE:
+    break;
+  case GB_MAPPER_MBC1:
+    if (address < 0x2000) {
+      mapper->ramEnable = (value & 0x0F) == 0x0A;
+    } else if (address < 0x4000) {
+      value &= 0x1F;
+      mapper->romBank = (mapper->romBank & 0x60) | (value ? value : 1);
+    } else if (address < 0x6000) {
+      mapper->romBank = (mapper->romBank & 0x1F) | ((value & 0x03) << 5);
+    }
+    break;
+  case GB_MAPPER_MBC3:
+    if (address < 0x2000) {
+      mapper->ramEnable = (value & 0x0F) == 0x0A;
+    } else if (address < 0x4000) {
+      value &= 0x7F;
+      mapper->romBank = value ? value : 1;
+    } else if (address < 0x6000) {
+      mapper->ramBank = value;
+    }
+    break;
+  case GB_MAPPER_MBC5:
+    if (address < 0x2000) {
+      mapper->ramEnable = (value & 0x0F) == 0x0A;
+    } else if (address < 0x3000) {
+      mapper->romBank = (mapper->romBank & 0x100) | value;
+    } else if (address < 0x4000) {
+      mapper->romBank = (mapper->romBank & 0xFF) | ((value & 0x01) << 8);
+    } else if (address < 0x6000) {
+      mapper->ramBank = value & 0x0F;
+    }
+    break;
+  }
+}
+
+static void markDirty(GBMemory *mem, addr address) {
+  byte page = (byte)(address >> 8);
+  mem->dirty[page >> 6] |= (uint64_t)1 << (page & 63);
+}
+
+void gbMemMarkDirty(GBMemory *mem, addr address) { markDirty(mem, address); }
+
+void gbMemMarkAllDirty(GBMemory *mem) {
+  memset(mem->dirty, 0xFF, sizeof(mem->dirty));
+}
+
+void gbMemClearDirty(GBMemory *mem) {
+  memset(mem->dirty, 0, sizeof(mem->dirty));
+  markDirty(mem, 0xFF00);
+}
+
+size_t gbMemDirtyPages(const GBMemory *mem, byte pages[GB_MEM_PAGES]) {
+  size_t count = 0;
+  for (int i = 0; i < GB_MEM_PAGES / 64; i++) {
+    uint64_t bits = mem->dirty[i];
+    while (bits != 0) {
+      pages[count++] = (byte)(i * 64 + __builtin_ctzll(bits));
+      bits &= bits - 1;
+    }
+  }
+  return count;
+}
+
+/* The cartridge RAM byte behind address, NULL while the mapper hides it */
+static byte *sramAt(GBMemory *mem, addr address) {
+  const GBMapper *mapper = &mem->mapper;
+  if (mapper->type != GB_MAPPER_NONE && !mapper->ramEnable)
+    return NULL;
+  size_t bank = mapper->type == GB_MAPPER_MBC1 ? 0 : mapper->ramBank;
+  if (mapper->type == GB_MAPPER_MBC3 && bank > 3)
+    return NULL; /* RTC registers, not emulated */
+  size_t offset = bank * GB_MEM_SRAM_BANK_SIZE + (address - 0xA000);
+  return &mem->sram[offset % mem->sramSize];
+}
+
 bool gbMemWrite(GBMemory *mem, addr address, byte value) {
   byte *ptr = NULL;
-  if (address <= GB_MEM_ROM_SIZE)
+  if (address < 0x8000 && mem->cart != NULL) {
+    mapperWrite(&mem->mapper, address, value);
+    return 0;
+  }
+  if (address >= 0xA000 && address < 0xC000 && mem->sram != NULL) {
+    if ((ptr = sramAt(mem, address)) != NULL) {
+      *ptr = value;
+      mem->sramDirty = true;
+    }
+    return 0;
+  }
+  if (address < GB_MEM_ROM_SIZE && mem->bootRom) {
     ptr = &mem->rom[address];
-  else
+  } else {
+    if (address >= 0xE000 && address < 0xFE00)
+      address -= 0x2000; /* echo of 0xC000-0xDDFF */
     ptr = &mem->ram[address];
+    markDirty(mem, address);
+  }
   *ptr = value;
   return 0;
 }
 
 byte *gbMemRead(GBMemory *mem, addr address) {
   byte *ptr = NULL;
-  if (address <= GB_MEM_ROM_SIZE)
+  if (address < GB_MEM_ROM_SIZE && mem->bootRom)
     ptr = &mem->rom[address];
+  else if (address < GB_MEM_ROM_BANK_SIZE && mem->cart != NULL)
+    ptr = &mem->cart[address % mem->cartSize];
+  else if (address < 0x8000 && mem->cart != NULL)
+    ptr = &mem->cart[((size_t)mem->mapper.romBank * GB_MEM_ROM_BANK_SIZE +
+                      (address - GB_MEM_ROM_BANK_SIZE)) %
+                     mem->cartSize];
+  else if (address >= 0xA000 && address < 0xC000 && mem->sram != NULL)
+    ptr = sramAt(mem, address);
+  else if (address >= 0xE000 && address < 0xFE00)
+    ptr = &mem->ram[address - 0x2000];
   else
     ptr = &mem->ram[address];
+  if (ptr == NULL) {
+    mem->openBus = 0xFF;
+    ptr = &mem->openBus;
+  }
   return ptr;
 }
\ No newline at end of file
@@ -1,21 +1,84 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "common.h"
 
-const char gbBootRom[0x100];
+extern const char gbBootRom[0x100];
 
 #define GB_MEM_ROM_SIZE sizeof(gbBootRom)
 #define GB_MEM_RAM_SIZE 0x10000
 
+#define GB_MEM_ROM_BANK_SIZE 0x4000
+#define GB_MEM_SRAM_BANK_SIZE 0x2000
+
+/*
+ * ram is tracked in 256 byte pages: gbMemWrite sets a page's dirty bit so
+ * snapshot consumers can copy only what changed since they last cleared. Page
+ * 0xFF (I/O and HRAM) is rewritten by the timer and PPU every frame and is
+ * always reported dirty.
+ */
+#define GB_MEM_PAGE_SIZE 0x100
+#define GB_MEM_PAGES (GB_MEM_RAM_SIZE / GB_MEM_PAGE_SIZE)
+
 typedef unsigned short addr;
 
+typedef enum {
+  GB_MAPPER_NONE,
+  GB_MAPPER_MBC1,
+  GB_MAPPER_MBC3,
+  GB_MAPPER_MBC5,
+} GBMapperType;
+
+typedef struct {
+  GBMapperType type;
+  word romBank; /* bank mapped at 0x4000-0x7FFF */
+  byte ramBank;
+  bool ramEnable;
+} GBMapper;
+
+/*
+ * Cartridge RAM, every bank, sits outside ram and is banked into
+ * 0xA000-0xBFFF by the mapper. For battery carts gbMemMapBattery replaces it
+ * with a MAP_SHARED view of the save file, so a store by the game is a store
+ * into the page cache: nothing is copied out on the emulation thread and the
+ * data outlives a crash of the process. gbMemSyncBattery only adds
+ * durability against the machine going down.
+ */
 typedef struct {
-  byte *rom;
+  byte *rom; /* boot ROM, overlays 0x0000-0x00FF until 0xFF50 is written */
   byte *ram;
+  byte *cart; /* cartridge ROM, NULL until gbMemLoadCart */
+  size_t cartSize;
+  byte *sram; /* cartridge RAM, NULL when the cart has none */
+  size_t sramSize;
+  bool battery;    /* the cart keeps sram powered */
+  bool sramMapped; /* sram is mmap'd from the battery file */
+  bool sramDirty;  /* written since the last gbMemSyncBattery */
+  byte openBus;    /* what disabled cartridge RAM reads as */
+  GBMapper mapper;
+  bool bootRom;
+  uint64_t dirty[GB_MEM_PAGES / 64];
 } GBMemory;
 
-GBMemory *gbMemNew();
+GBMemory *gbMemNew(void);
 void gbMemFree(GBMemory *mem);
 
+int gbMemLoadCart(GBMemory *mem, const byte *data, size_t size);
+
+/* After gbMemLoadCart; the file is created or grown to the RAM size */
+int gbMemMapBattery(GBMemory *mem, const char *path);
+/* Schedules (or with wait, completes) writeback of a dirty battery file */
+int gbMemSyncBattery(GBMemory *mem, bool wait);
+
 bool gbMemWrite(GBMemory *mem, addr address, byte value);
-byte *gbMemRead(GBMemory *mem, addr address);
\ No newline at end of file
+byte *gbMemRead(GBMemory *mem, addr address);
+
+/* For writes that bypass gbMemWrite, e.g. OAM DMA */
+void gbMemMarkDirty(GBMemory *mem, addr address);
+void gbMemMarkAllDirty(GBMemory *mem);
+void gbMemClearDirty(GBMemory *mem);
+
+/* Fills pages with the dirty page numbers in ascending order, returns count */
+size_t gbMemDirtyPages(const GBMemory *mem, byte pages[GB_MEM_PAGES]);
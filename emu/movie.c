@@ -0,0 +1,243 @@
+#include "movie.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state.h"
+
+#define MOVIE_MAGIC 0x564D4247 /* "GBMV" */
+#define MOVIE_BYTE_ORDER 0x01020304
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t stateSize;
+  uint64_t romHash;
+  uint64_t startCycle;
+  uint64_t endFrame;
+  uint64_t count;
+} MovieHeader;
+
+/* FNV-1a over the cartridge, 0 without one */
+static uint64_t romHash(const GBMemory *mem) {
+  if (mem->cart == NULL)
+    return 0;
+  uint64_t hash = 0xCBF29CE484222325;
+  for (size_t i = 0; i < mem->cartSize; i++)
+    hash = (hash ^ mem->cart[i]) * 0x100000001B3;
+  return hash;
+}
+
+static GBMovie *movieNew(size_t stateSize) {
+  GBMovie *movie = malloc(sizeof(GBMovie));
+  if (movie == NULL) {
+    gbSetError("<<gbMovieNew>> out of memory");
+    return NULL;
+  }
+  memset(movie, 0, sizeof(GBMovie));
+  movie->stateSize = stateSize;
+  movie->state = malloc(stateSize);
+  if (movie->state == NULL) {
+    gbSetError("<<gbMovieNew>> out of memory");
+    free(movie);
+    return NULL;
+  }
+  return movie;
+}
+
+static int reserve(GBMovie *movie, size_t count) {
+  if (count <= movie->capacity)
+    return 0;
+  size_t capacity = movie->capacity ? movie->capacity : 128;
+  do {
+    if (capacity > SIZE_MAX / 2 / sizeof(GBMovieEvent)) {
+      gbSetError("<<gbMovie>> too many events");
+      return 1;
+    }
+    capacity *= 2;
+  } while (capacity < count);
+  GBMovieEvent *events =
+      realloc(movie->events, capacity * sizeof(GBMovieEvent));
+  if (events == NULL) {
+    gbSetError("<<gbMovie>> out of memory");
+    return 1;
+  }
+  movie->events = events;
+  movie->capacity = capacity;
+  return 0;
+}
+
+GBMovie *gbMovieNew(const GB *gb) {
+  GBMovie *movie = movieNew(gbStateSize(gb));
+  if (movie == NULL)
+    return NULL;
+  gbStateSave(gb, movie->state, movie->stateSize);
+  movie->romHash = romHash(gb->mem);
+  movie->startCycle = gb->cycles;
+  movie->endFrame = gb->frame;
+  return movie;
+}
+
+void gbMovieFree(GBMovie *movie) {
+  free(movie->state);
+  free(movie->events);
+  free(movie);
+}
+
+void gbMovieSetButtons(GBMovie *movie, GB *gb, byte buttons) {
+  if (buttons == gb->buttons)
+    return;
+  if (reserve(movie, movie->count + 1) == 0)
+    movie->events[movie->count++] = (GBMovieEvent){gb->cycles, buttons};
+  gbSetButtons(gb, buttons);
+}
+
+static void putVarint(FILE *f, uint64_t v) {
+  while (v >= 0x80) {
+    fputc((int)(v & 0x7F) | 0x80, f);
+    v >>= 7;
+  }
+  fputc((int)v, f);
+}
+
+static int getVarint(FILE *f, uint64_t *v) {
+  int c;
+  int shift = 0;
+  *v = 0;
+  do {
+    if ((c = fgetc(f)) == EOF || shift > 63)
+      return 1;
+    *v |= (uint64_t)(c & 0x7F) << shift;
+    shift += 7;
+  } while (c & 0x80);
+  return 0;
+}
+
+int gbMovieSaveFile(GBMovie *movie, const GB *gb, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    gbSetError("<<gbMovieSaveFile>> cannot open %s", path);
+    return 1;
+  }
+
+  movie->endFrame = gb->frame;
+  MovieHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MOVIE_MAGIC;
+  header.version = GB_MOVIE_VERSION;
+  header.byteOrder = MOVIE_BYTE_ORDER;
+  header.stateSize = (uint32_t)movie->stateSize;
+  header.romHash = movie->romHash;
+  header.startCycle = movie->startCycle;
+  header.endFrame = movie->endFrame;
+  header.count = movie->count;
+  fwrite(&header, sizeof(header), 1, f);
+  fwrite(movie->state, 1, movie->stateSize, f);
+
+  uint64_t cycle = movie->startCycle;
+  for (size_t i = 0; i < movie->count; i++) {
+    putVarint(f, movie->events[i].cycle - cycle);
+    fputc(movie->events[i].buttons, f);
+    cycle = movie->events[i].cycle;
+  }
+
+  bool failed = ferror(f) != 0;
+  if (fclose(f) != 0 || failed) {
+    gbSetError("<<gbMovieSaveFile>> cannot write %s", path);
+    return 1;
+  }
+  return 0;
+}
+
+GBMovie *gbMovieLoadFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    gbSetError("<<gbMovieLoadFile>> cannot open %s", path);
+    return NULL;
+  }
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  MovieHeader header;
+  if (size < 0 || fread(&header, sizeof(header), 1, f) != 1 ||
+      header.magic != MOVIE_MAGIC || header.byteOrder != MOVIE_BYTE_ORDER) {
+    gbSetError("<<gbMovieLoadFile>> %s is not a movie", path);
+    fclose(f);
+    return NULL;
+  }
+  if (header.version != GB_MOVIE_VERSION) {
+    gbSetError("<<gbMovieLoadFile>> unsupported version %u", header.version);
+    fclose(f);
+    return NULL;
+  }
+  /* Every event takes at least a one byte varint and the buttons, so the
+   * counts can be checked before anything is allocated */
+  uint64_t payload = (uint64_t)size - sizeof(header);
+  if (header.stateSize > payload ||
+      header.count > (payload - header.stateSize) / 2) {
+    gbSetError("<<gbMovieLoadFile>> %s is truncated", path);
+    fclose(f);
+    return NULL;
+  }
+
+  GBMovie *movie = movieNew(header.stateSize);
+  if (movie == NULL) {
+    fclose(f);
+    return NULL;
+  }
+  movie->romHash = header.romHash;
+  movie->startCycle = header.startCycle;
+  movie->endFrame = header.endFrame;
+
+  bool ok = fread(movie->state, 1, movie->stateSize, f) == movie->stateSize &&
+            reserve(movie, (size_t)header.count) == 0;
+  uint64_t cycle = movie->startCycle;
+  for (uint64_t i = 0; ok && i < header.count; i++) {
+    uint64_t delta;
+    int buttons;
+    ok = getVarint(f, &delta) == 0 && (buttons = fgetc(f)) != EOF;
+    if (ok) {
+      cycle += delta;
+      movie->events[movie->count++] = (GBMovieEvent){cycle, (byte)buttons};
+    }
+  }
+  fclose(f);
+
+  if (!ok) {
+    gbSetError("<<gbMovieLoadFile>> %s is truncated", path);
+    gbMovieFree(movie);
+    return NULL;
+  }
+  return movie;
+}
+
+int gbMovieStart(GBMovie *movie, GB *gb) {
+  if (romHash(gb->mem) != movie->romHash) {
+    gbSetError("<<gbMovieStart>> movie was recorded with another cartridge");
+    return 1;
+  }
+  if (gbStateLoad(gb, movie->state, movie->stateSize) != 0)
+    return 1;
+  movie->cursor = 0;
+  return 0;
+}
+
+static void applyInput(GB *gb, void *user) {
+  GBMovie *movie = user;
+  while (movie->cursor < movie->count &&
+         movie->events[movie->cursor].cycle <= gb->cycles)
+    gbSetButtons(gb, movie->events[movie->cursor++].buttons);
+}
+
+void gbMovieRunFrame(GBMovie *movie, GB *gb) {
+  gbRunFrameWith(gb, applyInput, movie);
+}
+
+bool gbMovieFinished(const GBMovie *movie, const GB *gb) {
+  return gb->frame >= movie->endFrame;
+}
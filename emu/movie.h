@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * Input movies: a starting save state, a hash of the cartridge and every
+ * change of the held buttons stamped with the emulated cycle it happened on.
+ * Replaying applies each change on exactly that cycle, so a movie reproduces
+ * the recorded run bit for bit at any speed. On disk:
+ *
+ *   "GBMV" | u32 version | u32 0x01020304 | u32 state size | u64 rom hash
+ *   | u64 start cycle | u64 end frame | u64 event count | state | events
+ *
+ * where each event is a LEB128 cycle delta from the previous one (the first
+ * from the start cycle) followed by the button mask.
+ */
+
+#define GB_MOVIE_VERSION 1
+
+typedef struct {
+  uint64_t cycle;
+  byte buttons;
+} GBMovieEvent;
+
+typedef struct {
+  uint64_t romHash;
+  uint64_t startCycle; /* gb->cycles of the starting state */
+  uint64_t endFrame; /* replay is finished once gb->frame reaches it */
+  byte *state;
+  size_t stateSize;
+
+  GBMovieEvent *events;
+  size_t count;
+  size_t capacity;
+  size_t cursor; /* next event to replay */
+} GBMovie;
+
+/* Starts recording from gb's current state */
+GBMovie *gbMovieNew(const GB *gb);
+void gbMovieFree(GBMovie *movie);
+
+/* Records the change and applies it, use instead of gbSetButtons */
+void gbMovieSetButtons(GBMovie *movie, GB *gb, byte buttons);
+
+int gbMovieSaveFile(GBMovie *movie, const GB *gb, const char *path);
+GBMovie *gbMovieLoadFile(const char *path);
+
+/* Checks the cartridge and rewinds gb to the movie's starting state */
+int gbMovieStart(GBMovie *movie, GB *gb);
+/* Like gbRunFrame, applying recorded input on the cycle it was recorded */
+void gbMovieRunFrame(GBMovie *movie, GB *gb);
+bool gbMovieFinished(const GBMovie *movie, const GB *gb);
@@ -0,0 +1,193 @@
+#include "ppu.h"
+
+#include <string.h>
+
+#include "gb.h"
+
+#define OAM_SCAN_CYCLES 80
+#define TRANSFER_CYCLES 172
+#define MAX_LINE_SPRITES 10
+
+static byte tilePixel(const byte *ram, bool unsignedIndex, byte index, int x,
+                      int y) {
+  addr tile = unsignedIndex ? (addr)(0x8000 + index * 16)
+                            : (addr)(0x9000 + (signed char)index * 16);
+  byte lo = ram[tile + y * 2];
+  byte hi = ram[tile + y * 2 + 1];
+  return (byte)((getVal(hi, 7 - x) << 1) | getVal(lo, 7 - x));
+}
+
+static void renderLine(GB *gb) {
+  const byte *ram = gb->mem->ram;
+  GBPpu *ppu = &gb->ppu;
+  byte lcdc = ram[GB_IO_LCDC];
+  byte ly = ppu->ly;
+  byte *line = &ppu->framebuffer[ly * GB_LCD_WIDTH];
+
+  /* Raw colour indices, sprites need them for BG-over-OBJ priority */
+  byte bg[GB_LCD_WIDTH];
+  memset(bg, 0, sizeof(bg));
+
+  if (testBit(lcdc, 0)) {
+    bool unsignedIndex = testBit(lcdc, 4);
+    int wx = ram[GB_IO_WX] - 7;
+    bool window = testBit(lcdc, 5) && ly >= ram[GB_IO_WY] && wx < GB_LCD_WIDTH;
+    addr bgMap = testBit(lcdc, 3) ? 0x9C00 : 0x9800;
+    addr winMap = testBit(lcdc, 6) ? 0x9C00 : 0x9800;
+    byte y = (byte)(ly + ram[GB_IO_SCY]);
+
+    for (int x = 0; x < GB_LCD_WIDTH; x++) {
+      if (window && x >= wx) {
+        int wxp = x - wx;
+        byte index = ram[winMap + (ppu->windowLine / 8) * 32 + wxp / 8];
+        bg[x] = tilePixel(ram, unsignedIndex, index, wxp % 8,
+                          ppu->windowLine % 8);
+      } else {
+        byte xp = (byte)(x + ram[GB_IO_SCX]);
+        byte index = ram[bgMap + (y / 8) * 32 + xp / 8];
+        bg[x] = tilePixel(ram, unsignedIndex, index, xp % 8, y % 8);
+      }
+    }
+    if (window)
+      ppu->windowLine++;
+  }
+
+  byte bgp = ram[GB_IO_BGP];
+  for (int x = 0; x < GB_LCD_WIDTH; x++)
+    line[x] = (bgp >> (bg[x] * 2)) & 3;
+
+  if (!testBit(lcdc, 1))
+    return;
+
+  int height = testBit(lcdc, 2) ? 16 : 8;
+  const byte *sprites[MAX_LINE_SPRITES];
+  int count = 0;
+  for (int i = 0; i < 40 && count < MAX_LINE_SPRITES; i++) {
+    const byte *oam = &ram[0xFE00 + i * 4];
+    int sy = oam[0] - 16;
+    if (ly >= sy && ly < sy + height)
+      sprites[count++] = oam;
+  }
+
+  /* Sort by priority: lower X first, ties keep OAM order */
+  for (int i = 1; i < count; i++) {
+    const byte *s = sprites[i];
+    int j = i;
+    for (; j > 0 && sprites[j - 1][1] > s[1]; j--)
+      sprites[j] = sprites[j - 1];
+    sprites[j] = s;
+  }
+
+  /* Draw back to front so the highest priority sprite ends up on top */
+  for (int i = count - 1; i >= 0; i--) {
+    const byte *oam = sprites[i];
+    int sy = oam[0] - 16;
+    int sx = oam[1] - 8;
+    byte attr = oam[3];
+    byte tile = height == 16 ? oam[2] & 0xFE : oam[2];
+    int row = ly - sy;
+    if (testBit(attr, 6))
+      row = height - 1 - row;
+    byte obp = ram[testBit(attr, 4) ? GB_IO_OBP1 : GB_IO_OBP0];
+
+    for (int px = 0; px < 8; px++) {
+      int x = sx + px;
+      if (x < 0 || x >= GB_LCD_WIDTH)
+        continue;
+      byte color = tilePixel(ram, true, (byte)(tile + row / 8),
+                             testBit(attr, 5) ? 7 - px : px, row % 8);
+      if (color == 0 || (testBit(attr, 7) && bg[x] != 0))
+        continue;
+      line[x] = (obp >> (color * 2)) & 3;
+    }
+  }
+}
+
+static void updateStat(GB *gb) {
+  byte *ram = gb->mem->ram;
+  GBPpu *ppu = &gb->ppu;
+  byte stat = ram[GB_IO_STAT];
+  bool coincidence = ppu->ly == ram[GB_IO_LYC];
+
+  stat = (stat & 0xF8) | (coincidence ? 0x04 : 0) | ppu->mode;
+  ram[GB_IO_STAT] = stat;
+  ram[GB_IO_LY] = ppu->ly;
+
+  bool line = (testBit(stat, 3) && ppu->mode == GB_PPU_HBLANK) ||
+              (testBit(stat, 4) && ppu->mode == GB_PPU_VBLANK) ||
+              (testBit(stat, 5) && ppu->mode == GB_PPU_OAM) ||
+              (testBit(stat, 6) && coincidence);
+  if (line && !ppu->statLine)
+    gbRequestInterrupt(gb, GB_INT_STAT);
+  ppu->statLine = line;
+}
+
+/* Cycles until the next mode or line change, the only points where LY, STAT
+ * and the interrupts they drive can change */
+static int untilEvent(const GBPpu *ppu) {
+  int transferEnd = OAM_SCAN_CYCLES + TRANSFER_CYCLES;
+  if (ppu->ly >= GB_LCD_HEIGHT || ppu->dot >= transferEnd)
+    return GB_LINE_CYCLES - ppu->dot;
+  if (ppu->dot >= OAM_SCAN_CYCLES)
+    return transferEnd - ppu->dot;
+  return OAM_SCAN_CYCLES - ppu->dot;
+}
+
+void gbPpuSync(GB *gb) {
+  GBPpu *ppu = &gb->ppu;
+  uint64_t elapsed = gb->cycles - ppu->time;
+  ppu->time = gb->cycles;
+
+  if (!testBit(gb->mem->ram[GB_IO_LCDC], 7)) {
+    ppu->dot = 0;
+    ppu->ly = 0;
+    ppu->windowLine = 0;
+    ppu->mode = GB_PPU_HBLANK;
+    updateStat(gb);
+    ppu->next = UINT64_MAX;
+    return;
+  }
+
+  /* Never more than one event behind, gbStep syncs as soon as it is due */
+  ppu->dot += (int)elapsed;
+  if (ppu->dot >= GB_LINE_CYCLES) {
+    ppu->dot -= GB_LINE_CYCLES;
+    ppu->ly++;
+    if (ppu->ly == GB_LCD_HEIGHT)
+      gbRequestInterrupt(gb, GB_INT_VBLANK);
+    if (ppu->ly == GB_FRAME_LINES) {
+      ppu->ly = 0;
+      ppu->windowLine = 0;
+    }
+  }
+
+  GBPpuMode mode;
+  if (ppu->ly >= GB_LCD_HEIGHT)
+    mode = GB_PPU_VBLANK;
+  else if (ppu->dot < OAM_SCAN_CYCLES)
+    mode = GB_PPU_OAM;
+  else if (ppu->dot < OAM_SCAN_CYCLES + TRANSFER_CYCLES)
+    mode = GB_PPU_TRANSFER;
+  else
+    mode = GB_PPU_HBLANK;
+
+  /* The whole line is composed at once when pixel transfer finishes */
+  if (mode == GB_PPU_HBLANK && ppu->mode == GB_PPU_TRANSFER)
+    renderLine(gb);
+
+  ppu->mode = mode;
+  updateStat(gb);
+  ppu->next = ppu->time + (uint64_t)untilEvent(ppu);
+}
+
+void gbPpuWrite(GB *gb, addr address, byte value) {
+  byte *ram = gb->mem->ram;
+  gbPpuSync(gb);
+
+  if (address == GB_IO_STAT)
+    ram[GB_IO_STAT] = 0x80 | (value & 0x78) | (ram[GB_IO_STAT] & 0x07);
+  else
+    gbMemWrite(gb->mem, address, value);
+  /* The new value takes effect when the current instruction completes */
+  gb->ppu.next = gb->cycles;
+}
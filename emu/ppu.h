@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "common.h"
+#include "mem.h"
+
+#define GB_LCD_WIDTH 160
+#define GB_LCD_HEIGHT 144
+
+#define GB_FRAMEBUFFER_SIZE (GB_LCD_WIDTH * GB_LCD_HEIGHT)
+
+#define GB_LINE_CYCLES 456
+#define GB_FRAME_LINES 154
+#define GB_FRAME_CYCLES (GB_LINE_CYCLES * GB_FRAME_LINES)
+
+typedef enum {
+  GB_PPU_HBLANK = 0,
+  GB_PPU_VBLANK = 1,
+  GB_PPU_OAM = 2,
+  GB_PPU_TRANSFER = 3,
+} GBPpuMode;
+
+typedef struct {
+  int dot; /* position within the current line, 0..GB_LINE_CYCLES-1 */
+  byte ly;
+  byte windowLine;
+  GBPpuMode mode;
+  bool statLine; /* STAT interrupt line, requests fire on its rising edge */
+  uint64_t time; /* cycle dot has been advanced to */
+  uint64_t next; /* cycle of the next mode change, UINT64_MAX if LCD is off */
+  /* one shade (0 = white .. 3 = black) per pixel, after BGP/OBP mapping */
+  byte framebuffer[GB_FRAMEBUFFER_SIZE];
+} GBPpu;
+
+struct GB;
+
+/* Advances to the current cycle, rendering the line when transfer ends */
+void gbPpuSync(struct GB *gb);
+/* LCDC, STAT and LYC, they can change the mode or raise the STAT line */
+void gbPpuWrite(struct GB *gb, addr address, byte value);
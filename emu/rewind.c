@@ -0,0 +1,246 @@
+#include "rewind.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state.h"
+
+static uint64_t load64(const byte *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/* dst ^= src, a word at a time so it vectorizes */
+static void xorInto(byte *dst, const byte *src, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t v = load64(dst + i) ^ load64(src + i);
+    memcpy(dst + i, &v, sizeof(v));
+  }
+  for (; i < n; i++)
+    dst[i] ^= src[i];
+}
+
+static size_t putVarint(byte *out, size_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    out[n++] = (byte)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (byte)v;
+  return n;
+}
+
+static size_t getVarint(const byte *in, size_t *v) {
+  size_t n = 0;
+  int shift = 0;
+  *v = 0;
+  do {
+    *v |= (size_t)(in[n] & 0x7F) << shift;
+    shift += 7;
+  } while (in[n++] & 0x80);
+  return n;
+}
+
+/*
+ * A delta is a list of (zero run, literal length, literal bytes) tokens.
+ * Literals only stop at four or more zeros so short gaps don't cost a token.
+ */
+static size_t encode(const byte *src, size_t n, byte *out) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < n) {
+    size_t start = i;
+    while (i + 8 <= n && load64(src + i) == 0)
+      i += 8;
+    while (i < n && src[i] == 0)
+      i++;
+    size_t zeros = i - start;
+
+    size_t literal = i;
+    while (i < n) {
+      if (src[i] == 0 &&
+          (i + 4 > n || (src[i + 1] | src[i + 2] | src[i + 3]) == 0))
+        break;
+      i++;
+    }
+
+    o += putVarint(out + o, zeros);
+    o += putVarint(out + o, i - literal);
+    memcpy(out + o, src + literal, i - literal);
+    o += i - literal;
+  }
+  return o;
+}
+
+static void applyDelta(byte *dst, const byte *in, size_t length) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < length) {
+    size_t zeros, literal;
+    i += getVarint(in + i, &zeros);
+    i += getVarint(in + i, &literal);
+    o += zeros;
+    xorInto(dst + o, in + i, literal);
+    o += literal;
+    i += literal;
+  }
+}
+
+GBRewind *gbRewindNew(const GB *gb, size_t budget, size_t maxStates) {
+  GBRewind *rewind = malloc(sizeof(GBRewind));
+  if (rewind == NULL) {
+    gbSetError("<<gbRewindNew>> out of memory");
+    return NULL;
+  }
+  memset(rewind, 0, sizeof(GBRewind));
+
+  rewind->stateSize = gbStateSize(gb);
+  rewind->ramOffset = gbStateRamOffset(gb);
+  rewind->current = malloc(rewind->stateSize);
+  rewind->scratch = malloc(rewind->stateSize);
+  rewind->encoded = malloc(rewind->stateSize * 2 + 16);
+  rewind->ring = malloc(budget);
+  rewind->ringSize = budget;
+  /* a history of zero states still needs a valid array to index */
+  rewind->entries =
+      malloc(sizeof(GBRewindEntry) * (maxStates > 0 ? maxStates : 1));
+  rewind->maxEntries = maxStates;
+
+  if (rewind->current == NULL || rewind->scratch == NULL ||
+      rewind->encoded == NULL || rewind->ring == NULL ||
+      rewind->entries == NULL) {
+    gbSetError("<<gbRewindNew>> cannot allocate a %zu byte history", budget);
+    gbRewindFree(rewind);
+    return NULL;
+  }
+  return rewind;
+}
+
+void gbRewindFree(GBRewind *rewind) {
+  free(rewind->current);
+  free(rewind->scratch);
+  free(rewind->encoded);
+  free(rewind->ring);
+  free(rewind->entries);
+  free(rewind);
+}
+
+void gbRewindClear(GBRewind *rewind) {
+  rewind->hasCurrent = false;
+  rewind->ringHead = 0;
+  rewind->first = 0;
+  rewind->count = 0;
+}
+
+static void dropOldest(GBRewind *rewind) {
+  rewind->first = (rewind->first + 1) % rewind->maxEntries;
+  rewind->count--;
+}
+
+static void push(GBRewind *rewind, const byte *data, size_t length) {
+  if (length > rewind->ringSize || rewind->maxEntries == 0) {
+    /* can't be stored, and older deltas are useless without it */
+    rewind->first = rewind->count = rewind->ringHead = 0;
+    return;
+  }
+
+  if (rewind->ringHead + length > rewind->ringSize) {
+    /* whatever sits past the head is older than what's before it */
+    while (rewind->count > 0 &&
+           rewind->entries[rewind->first].offset >= rewind->ringHead)
+      dropOldest(rewind);
+    rewind->ringHead = 0;
+  }
+  while (rewind->count > 0 &&
+         rewind->entries[rewind->first].offset >= rewind->ringHead &&
+         rewind->entries[rewind->first].offset < rewind->ringHead + length)
+    dropOldest(rewind);
+  if (rewind->count == rewind->maxEntries)
+    dropOldest(rewind);
+
+  memcpy(rewind->ring + rewind->ringHead, data, length);
+  GBRewindEntry *entry =
+      &rewind->entries[(rewind->first + rewind->count) % rewind->maxEntries];
+  entry->offset = rewind->ringHead;
+  entry->length = length;
+  rewind->count++;
+  rewind->ringHead += length;
+}
+
+/*
+ * scratch = new ^ current is the delta back to current, then current ^= delta
+ * turns current into the new state without a second save. Both passes only
+ * visit ram pages written since the last capture.
+ */
+static void makeDelta(GBRewind *rewind, GBMemory *mem) {
+  byte *ram = rewind->scratch + rewind->ramOffset;
+  const byte *old = rewind->current + rewind->ramOffset;
+  size_t tail = rewind->ramOffset + GB_MEM_RAM_SIZE;
+
+  xorInto(rewind->scratch, rewind->current, rewind->ramOffset);
+  for (int page = 0; page < GB_MEM_PAGES; page++) {
+    size_t at = (size_t)page * GB_MEM_PAGE_SIZE;
+    if (mem->dirty[page >> 6] & ((uint64_t)1 << (page & 63)))
+      xorInto(ram + at, old + at, GB_MEM_PAGE_SIZE);
+    else
+      memset(ram + at, 0, GB_MEM_PAGE_SIZE);
+  }
+  xorInto(rewind->scratch + tail, rewind->current + tail,
+          rewind->stateSize - tail);
+}
+
+static void applyChanged(GBRewind *rewind, GBMemory *mem) {
+  byte *ram = rewind->current + rewind->ramOffset;
+  const byte *delta = rewind->scratch + rewind->ramOffset;
+  size_t tail = rewind->ramOffset + GB_MEM_RAM_SIZE;
+
+  xorInto(rewind->current, rewind->scratch, rewind->ramOffset);
+  byte pages[GB_MEM_PAGES];
+  size_t count = gbMemDirtyPages(mem, pages);
+  for (size_t i = 0; i < count; i++) {
+    size_t at = (size_t)pages[i] * GB_MEM_PAGE_SIZE;
+    xorInto(ram + at, delta + at, GB_MEM_PAGE_SIZE);
+  }
+  xorInto(rewind->current + tail, rewind->scratch + tail,
+          rewind->stateSize - tail);
+}
+
+void gbRewindCapture(GBRewind *rewind, GB *gb) {
+  if (!rewind->hasCurrent) {
+    gbStateSave(gb, rewind->current, rewind->stateSize);
+    gbMemClearDirty(gb->mem);
+    rewind->hasCurrent = true;
+    return;
+  }
+
+  gbStateSave(gb, rewind->scratch, rewind->stateSize);
+  makeDelta(rewind, gb->mem);
+  size_t length = encode(rewind->scratch, rewind->stateSize, rewind->encoded);
+  applyChanged(rewind, gb->mem);
+  gbMemClearDirty(gb->mem);
+
+  push(rewind, rewind->encoded, length);
+}
+
+int gbRewindStep(GBRewind *rewind, GB *gb) {
+  if (!rewind->hasCurrent) {
+    gbSetError("<<gbRewindStep>> nothing captured");
+    return 1;
+  }
+  /* gbStateLoad leaves gb untouched on failure, the history stays too */
+  if (gbStateLoad(gb, rewind->current, rewind->stateSize) != 0)
+    return 1;
+
+  if (rewind->count > 0) {
+    GBRewindEntry *entry =
+        &rewind->entries[(rewind->first + rewind->count - 1) %
+                         rewind->maxEntries];
+    applyDelta(rewind->current, rewind->ring + entry->offset, entry->length);
+    rewind->ringHead = entry->offset;
+    rewind->count--;
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "gb.h"
+
+/*
+ * Rewind history. The newest state is kept uncompressed; every older state is
+ * stored as the XOR of itself and its successor, zero-run compressed, in a
+ * fixed-size byte ring. Consecutive frames differ in a few hundred bytes, so a
+ * delta is usually tens of bytes and capture costs a couple of passes over an
+ * ~88 KB state. Memory pages that gbMemWrite left clean since the previous
+ * capture are known to be unchanged and skipped, so capture clears the dirty
+ * bits; nothing else may rely on them while a history is recording.
+ */
+
+typedef struct {
+  size_t offset; /* into ring */
+  size_t length;
+} GBRewindEntry;
+
+typedef struct {
+  size_t stateSize;
+  size_t ramOffset; /* of the ram payload inside a state */
+  byte *current; /* newest captured state */
+  bool hasCurrent;
+  byte *scratch; /* delta being built */
+  byte *encoded; /* compressed delta before it is copied into the ring */
+
+  byte *ring;
+  size_t ringSize;
+  size_t ringHead; /* next write offset */
+
+  GBRewindEntry *entries; /* oldest first, circular */
+  size_t maxEntries;
+  size_t first;
+  size_t count;
+} GBRewind;
+
+/* budget bounds the compressed deltas, maxStates bounds how far back to go */
+GBRewind *gbRewindNew(const GB *gb, size_t budget, size_t maxStates);
+void gbRewindFree(GBRewind *rewind);
+
+/* Also clears gb's dirty page bits, see above */
+void gbRewindCapture(GBRewind *rewind, GB *gb);
+
+/*
+ * Loads the newest captured state into gb and drops it from the history, so
+ * repeated calls walk backwards until they stick at the oldest state. Returns 1
+ * and sets the error when nothing was captured or the state fails to load.
+ */
+int gbRewindStep(GBRewind *rewind, GB *gb);
+
+void gbRewindClear(GBRewind *rewind);
@@ -0,0 +1,202 @@
+#include "runahead.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state.h"
+
+struct GBRunAhead {
+  int frames;
+  byte *state;
+  size_t stateSize;
+  byte framebuffer[GB_FRAMEBUFFER_SIZE];
+
+  /* threaded mode only */
+  GB *shadow;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  bool pending; /* state holds a frame the worker hasn't finished */
+  bool quit;
+};
+
+static void *worker(void *arg) {
+  GBRunAhead *ahead = arg;
+  gbTraceSetThreadName("run-ahead");
+
+  pthread_mutex_lock(&ahead->lock);
+  for (;;) {
+    while (!ahead->quit && !ahead->pending)
+      pthread_cond_wait(&ahead->wake, &ahead->lock);
+    if (ahead->quit)
+      break;
+    int frames = ahead->frames;
+    pthread_mutex_unlock(&ahead->lock);
+
+    GB_TRACE_BEGIN("run-ahead");
+    if (gbStateLoad(ahead->shadow, ahead->state, ahead->stateSize) == 0) {
+      for (int i = 0; i < frames; i++)
+        gbRunFrame(ahead->shadow);
+    }
+    GB_TRACE_END("run-ahead");
+    memcpy(ahead->framebuffer, gbGetFramebuffer(ahead->shadow),
+           GB_FRAMEBUFFER_SIZE);
+
+    pthread_mutex_lock(&ahead->lock);
+    ahead->pending = false;
+    pthread_cond_signal(&ahead->done);
+  }
+  pthread_mutex_unlock(&ahead->lock);
+  return NULL;
+}
+
+GBRunAhead *gbRunAheadNew(const GB *gb, int frames, bool threaded) {
+  GBRunAhead *ahead = malloc(sizeof(GBRunAhead));
+  if (ahead == NULL) {
+    gbSetError("<<gbRunAheadNew>> out of memory");
+    return NULL;
+  }
+  memset(ahead, 0, sizeof(GBRunAhead));
+  ahead->frames = frames;
+  ahead->stateSize = gbStateSize(gb);
+  ahead->state = malloc(ahead->stateSize);
+  if (ahead->state == NULL) {
+    gbSetError("<<gbRunAheadNew>> out of memory");
+    free(ahead);
+    return NULL;
+  }
+  memcpy(ahead->framebuffer, gbGetFramebuffer(gb), GB_FRAMEBUFFER_SIZE);
+  if (!threaded)
+    return ahead;
+
+  ahead->shadow = gbNew();
+  if (ahead->shadow == NULL) {
+    gbSetError("<<gbRunAheadNew>> out of memory");
+    free(ahead->state);
+    free(ahead);
+    return NULL;
+  }
+  if (gb->mem->cart != NULL &&
+      gbLoadRom(ahead->shadow, gb->mem->cart, gb->mem->cartSize) != 0) {
+    gbFree(ahead->shadow);
+    free(ahead->state);
+    free(ahead);
+    return NULL;
+  }
+
+  pthread_mutex_init(&ahead->lock, NULL);
+  pthread_cond_init(&ahead->wake, NULL);
+  pthread_cond_init(&ahead->done, NULL);
+  if (pthread_create(&ahead->thread, NULL, worker, ahead) != 0) {
+    gbSetError("<<gbRunAheadNew>> cannot start worker");
+    pthread_cond_destroy(&ahead->done);
+    pthread_cond_destroy(&ahead->wake);
+    pthread_mutex_destroy(&ahead->lock);
+    gbFree(ahead->shadow);
+    free(ahead->state);
+    free(ahead);
+    return NULL;
+  }
+  return ahead;
+}
+
+void gbRunAheadFree(GBRunAhead *ahead) {
+  if (ahead->shadow != NULL) {
+    pthread_mutex_lock(&ahead->lock);
+    ahead->quit = true;
+    pthread_cond_signal(&ahead->wake);
+    pthread_mutex_unlock(&ahead->lock);
+    pthread_join(ahead->thread, NULL);
+
+    pthread_cond_destroy(&ahead->done);
+    pthread_cond_destroy(&ahead->wake);
+    pthread_mutex_destroy(&ahead->lock);
+    gbFree(ahead->shadow);
+  }
+  free(ahead->state);
+  free(ahead);
+}
+
+static void waitForWorker(GBRunAhead *ahead) {
+  pthread_mutex_lock(&ahead->lock);
+  while (ahead->pending)
+    pthread_cond_wait(&ahead->done, &ahead->lock);
+  pthread_mutex_unlock(&ahead->lock);
+}
+
+void gbRunAheadSetFrames(GBRunAhead *ahead, int frames) {
+  if (ahead->shadow != NULL)
+    waitForWorker(ahead);
+  ahead->frames = frames;
+}
+
+/* Observers that must only see frames that really happen */
+typedef struct {
+  struct GBBlip *blip;
+  struct GBITrace *itrace;
+  struct GBDebug *debug;
+#ifdef GB_HOTSPOTS
+  struct GBHotspots *hotspots;
+#endif
+} Observers;
+
+static Observers detach(GB *gb) {
+  Observers saved = {gb->blip, gb->itrace, gb->debug,
+#ifdef GB_HOTSPOTS
+                     gb->hotspots
+#endif
+  };
+  gb->blip = NULL;
+  gb->itrace = NULL;
+  gb->debug = NULL;
+#ifdef GB_HOTSPOTS
+  gb->hotspots = NULL;
+#endif
+  return saved;
+}
+
+static void reattach(GB *gb, const Observers *saved) {
+  gb->blip = saved->blip;
+  gb->itrace = saved->itrace;
+  gb->debug = saved->debug;
+#ifdef GB_HOTSPOTS
+  gb->hotspots = saved->hotspots;
+#endif
+}
+
+void gbRunAheadFrame(GBRunAhead *ahead, GB *gb) {
+  if (ahead->shadow != NULL)
+    waitForWorker(ahead);
+  gbRunFrame(gb);
+
+  if (ahead->frames <= 0) {
+    memcpy(ahead->framebuffer, gbGetFramebuffer(gb), GB_FRAMEBUFFER_SIZE);
+    return;
+  }
+
+  if (ahead->shadow == NULL) {
+    /* the speculative frames are never heard, traced or broken into */
+    Observers saved = detach(gb);
+    gbStateSave(gb, ahead->state, ahead->stateSize);
+    for (int i = 0; i < ahead->frames; i++)
+      gbRunFrame(gb);
+    memcpy(ahead->framebuffer, gbGetFramebuffer(gb), GB_FRAMEBUFFER_SIZE);
+    gbStateLoad(gb, ahead->state, ahead->stateSize);
+    reattach(gb, &saved);
+    return;
+  }
+
+  gbStateSave(gb, ahead->state, ahead->stateSize);
+  pthread_mutex_lock(&ahead->lock);
+  ahead->pending = true;
+  pthread_cond_signal(&ahead->wake);
+  pthread_mutex_unlock(&ahead->lock);
+}
+
+const byte *gbRunAheadFramebuffer(GBRunAhead *ahead) {
+  if (ahead->shadow != NULL)
+    waitForWorker(ahead);
+  return ahead->framebuffer;
+}
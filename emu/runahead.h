@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "gb.h"
+
+/*
+ * Run-ahead hides the input lag games build in: every host frame the real
+ * instance advances one frame, then a copy of it is run `frames` more frames
+ * with the same input and that speculative picture is shown instead. The copy
+ * is either the real instance itself, saved and restored around the extra
+ * frames, or a second instance that a worker thread brings up to date from a
+ * save state while the caller goes on drawing. Opaque so embedders don't depend
+ * on its layout.
+ */
+typedef struct GBRunAhead GBRunAhead;
+
+/* Create after the cartridge is loaded, the second instance copies it */
+GBRunAhead *gbRunAheadNew(const GB *gb, int frames, bool threaded);
+void gbRunAheadFree(GBRunAhead *ahead);
+
+void gbRunAheadSetFrames(GBRunAhead *ahead, int frames);
+
+/* Runs one real frame on gb and starts the speculative ones */
+void gbRunAheadFrame(GBRunAhead *ahead, GB *gb);
+
+/*
+ * Waits for the speculative frames and returns the picture to present, valid
+ * until the next gbRunAheadFrame
+ */
+const byte *gbRunAheadFramebuffer(GBRunAhead *ahead);
@@ -0,0 +1,178 @@
+#include "search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const char *const gbSearchOpNames[GB_SEARCH_OP_COUNT] = {
+    "equal to", "not equal to", "increased", "decreased", "unchanged",
+    "changed",
+};
+
+static const struct {
+  addr start, end; /* inclusive */
+} Regions[] = {
+    {0xA000, 0xBFFF}, /* cartridge RAM */
+    {0xC000, 0xDFFF}, /* WRAM */
+    {0xFF80, 0xFFFE}, /* HRAM */
+};
+
+GBSearch *gbSearchNew(void) {
+  GBSearch *search = malloc(sizeof(GBSearch));
+  if (search == NULL) {
+    gbSetError("<<gbSearchNew>> out of memory");
+    return NULL;
+  }
+  memset(search, 0, sizeof(GBSearch));
+  return search;
+}
+
+void gbSearchFree(GBSearch *search) { free(search); }
+
+static void setBits(uint64_t *bits, size_t from, size_t to) {
+  for (size_t i = from; i <= to; i++)
+    bits[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+static size_t countBits(const uint64_t *bits) {
+  size_t count = 0;
+  for (size_t i = 0; i < 0x10000 / 64; i++)
+    count += (size_t)__builtin_popcountll(bits[i]);
+  return count;
+}
+
+void gbSearchReset(GBSearch *search, const byte *mem, bool wide) {
+  search->wide = wide;
+  memset(search->candidates, 0, sizeof(search->candidates));
+  /* a 16-bit value has to fit in the region */
+  for (size_t i = 0; i < sizeof(Regions) / sizeof(Regions[0]); i++)
+    setBits(search->candidates, Regions[i].start, Regions[i].end - wide);
+  search->count = countBits(search->candidates);
+  memcpy(search->previous, mem, 0x10000);
+}
+
+#ifdef __SSE2__
+/* a > b for unsigned bytes or words */
+static __m128i greater8(__m128i a, __m128i b) {
+  return _mm_xor_si128(_mm_cmpeq_epi8(_mm_min_epu8(a, b), a),
+                       _mm_set1_epi8(-1));
+}
+
+static __m128i greater16(__m128i a, __m128i b) {
+  __m128i bias = _mm_set1_epi16((short)0x8000);
+  return _mm_cmpgt_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+}
+
+static __m128i match(__m128i cur, __m128i prev, __m128i value, GBSearchOp op,
+                     bool wide) {
+  switch (op) {
+  case GB_SEARCH_EQUAL:
+    return wide ? _mm_cmpeq_epi16(cur, value) : _mm_cmpeq_epi8(cur, value);
+  case GB_SEARCH_NOT_EQUAL:
+    return _mm_xor_si128(wide ? _mm_cmpeq_epi16(cur, value)
+                              : _mm_cmpeq_epi8(cur, value),
+                         _mm_set1_epi8(-1));
+  case GB_SEARCH_INCREASED:
+    return wide ? greater16(cur, prev) : greater8(cur, prev);
+  case GB_SEARCH_DECREASED:
+    return wide ? greater16(prev, cur) : greater8(prev, cur);
+  case GB_SEARCH_UNCHANGED:
+    return wide ? _mm_cmpeq_epi16(cur, prev) : _mm_cmpeq_epi8(cur, prev);
+  default:
+    return _mm_xor_si128(wide ? _mm_cmpeq_epi16(cur, prev)
+                              : _mm_cmpeq_epi8(cur, prev),
+                         _mm_set1_epi8(-1));
+  }
+}
+
+/* One bit per address for the 16 addresses starting at at */
+static uint32_t match16(const GBSearch *search, size_t at, GBSearchOp op,
+                        __m128i value) {
+  const byte *cur = search->current + at;
+  const byte *prev = search->previous + at;
+  if (!search->wide) {
+    __m128i m = match(_mm_loadu_si128((const __m128i *)cur),
+                      _mm_loadu_si128((const __m128i *)prev), value, op, false);
+    return (uint32_t)_mm_movemask_epi8(m);
+  }
+  /* words at even addresses, then at odd ones; each word result sets both
+   * of its mask bits, keep the low one and interleave */
+  __m128i even = match(_mm_loadu_si128((const __m128i *)cur),
+                       _mm_loadu_si128((const __m128i *)prev), value, op, true);
+  __m128i odd =
+      match(_mm_loadu_si128((const __m128i *)(cur + 1)),
+            _mm_loadu_si128((const __m128i *)(prev + 1)), value, op, true);
+  return ((uint32_t)_mm_movemask_epi8(even) & 0x5555) |
+         (((uint32_t)_mm_movemask_epi8(odd) & 0x5555) << 1);
+}
+#else
+static bool match(unsigned cur, unsigned prev, unsigned value,
+                  GBSearchOp op) {
+  switch (op) {
+  case GB_SEARCH_EQUAL:
+    return cur == value;
+  case GB_SEARCH_NOT_EQUAL:
+    return cur != value;
+  case GB_SEARCH_INCREASED:
+    return cur > prev;
+  case GB_SEARCH_DECREASED:
+    return cur < prev;
+  case GB_SEARCH_UNCHANGED:
+    return cur == prev;
+  default:
+    return cur != prev;
+  }
+}
+
+static uint32_t match16(const GBSearch *search, size_t at, GBSearchOp op,
+                        word value) {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < 16; i++) {
+    const byte *cur = search->current + at + i;
+    const byte *prev = search->previous + at + i;
+    unsigned c = search->wide ? (unsigned)(cur[0] | cur[1] << 8) : cur[0];
+    unsigned p = search->wide ? (unsigned)(prev[0] | prev[1] << 8) : prev[0];
+    mask |= (uint32_t)match(c, p, value, op) << i;
+  }
+  return mask;
+}
+#endif
+
+size_t gbSearchFilter(GBSearch *search, const byte *mem, GBSearchOp op,
+                      word value) {
+  memcpy(search->current, mem, 0x10000);
+#ifdef __SSE2__
+  __m128i v = search->wide ? _mm_set1_epi16((short)value)
+                           : _mm_set1_epi8((char)value);
+#else
+  word v = search->wide ? value : (byte)value;
+#endif
+
+  size_t count = 0;
+  for (size_t i = 0; i < 0x10000 / 64; i++) {
+    uint64_t bits = search->candidates[i];
+    if (bits == 0)
+      continue;
+    uint64_t keep = 0;
+    for (int j = 0; j < 4; j++)
+      keep |= (uint64_t)match16(search, i * 64 + j * 16, op, v) << (j * 16);
+    bits &= keep;
+    search->candidates[i] = bits;
+    count += (size_t)__builtin_popcountll(bits);
+  }
+  search->count = count;
+  memcpy(search->previous, search->current, 0x10000);
+  return count;
+}
+
+size_t gbSearchResults(const GBSearch *search, addr *out, size_t max) {
+  size_t n = 0;
+  for (size_t i = 0; i < 0x10000 / 64 && n < max; i++)
+    for (uint64_t bits = search->candidates[i]; bits != 0 && n < max;
+         bits &= bits - 1)
+      out[n++] = (addr)(i * 64 + (size_t)__builtin_ctzll(bits));
+  return n;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * Cheat finder over the writable memory games keep state in: cartridge RAM,
+ * WRAM and HRAM. Candidates are a bitmap over the 64K bus; each filter step
+ * compares a bus image (normally a GBMemSnapshot view) against a value or
+ * against the image of the previous step and clears the addresses that don't
+ * match, 16 at a time with SSE2. 64 address blocks with no candidates left
+ * are skipped, so steps get cheaper as the set narrows. 16-bit values are
+ * little endian and start at the candidate address.
+ */
+
+typedef enum {
+  GB_SEARCH_EQUAL, /* to value */
+  GB_SEARCH_NOT_EQUAL,
+  GB_SEARCH_INCREASED, /* since the previous step */
+  GB_SEARCH_DECREASED,
+  GB_SEARCH_UNCHANGED,
+  GB_SEARCH_CHANGED,
+  GB_SEARCH_OP_COUNT
+} GBSearchOp;
+
+extern const char *const gbSearchOpNames[GB_SEARCH_OP_COUNT];
+
+typedef struct {
+  bool wide; /* 16-bit values */
+  uint64_t candidates[0x10000 / 64];
+  size_t count;
+  /* bus images, padded so 16 byte loads past 0xFFFF stay inside */
+  byte previous[0x10000 + 16];
+  byte current[0x10000 + 16];
+} GBSearch;
+
+GBSearch *gbSearchNew(void);
+void gbSearchFree(GBSearch *search);
+
+/* Makes every searchable address a candidate again and remembers mem */
+void gbSearchReset(GBSearch *search, const byte *mem, bool wide);
+
+/* Keeps the candidates whose value in mem passes op, returns how many */
+size_t gbSearchFilter(GBSearch *search, const byte *mem, GBSearchOp op,
+                      word value);
+
+/* Up to max remaining candidates in address order, returns how many */
+size_t gbSearchResults(const GBSearch *search, addr *out, size_t max);
@@ -0,0 +1,137 @@
+#include "snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+GBMemSnapshot *gbMemSnapshotNew(void) {
+  GBMemSnapshot *snapshot = malloc(sizeof(GBMemSnapshot));
+  if (snapshot == NULL) {
+    gbSetError("<<gbMemSnapshotNew>> out of memory");
+    return NULL;
+  }
+  memset(snapshot, 0, sizeof(GBMemSnapshot));
+  atomic_init(&snapshot->front, 0);
+  atomic_init(&snapshot->reading, -1);
+  memset(snapshot->changedAt, 0xFF, sizeof(snapshot->changedAt));
+  pthread_mutex_init(&snapshot->lock, NULL);
+  return snapshot;
+}
+
+void gbMemSnapshotFree(GBMemSnapshot *snapshot) {
+  pthread_mutex_destroy(&snapshot->lock);
+  free(snapshot);
+}
+
+/* Pages are contiguous in every mapping unless the cartridge size isn't a
+ * multiple of a page and one wraps around */
+static void copyBus(GBMemory *mem, byte *out) {
+  for (size_t at = 0; at < 0x10000; at += GB_MEM_PAGE_SIZE) {
+    const byte *page = gbMemRead(mem, (addr)at);
+    if (gbMemRead(mem, (addr)(at + GB_MEM_PAGE_SIZE - 1)) ==
+        page + GB_MEM_PAGE_SIZE - 1) {
+      memcpy(out + at, page, GB_MEM_PAGE_SIZE);
+      continue;
+    }
+    for (size_t i = 0; i < GB_MEM_PAGE_SIZE; i++)
+      out[at + i] = *gbMemRead(mem, (addr)(at + i));
+  }
+}
+
+void gbMemSnapshotPublish(GBMemSnapshot *snapshot, GB *gb) {
+  GBMemEdit edits[GB_SNAPSHOT_EDITS];
+  pthread_mutex_lock(&snapshot->lock);
+  int count = snapshot->editCount;
+  memcpy(edits, snapshot->edits, (size_t)count * sizeof(GBMemEdit));
+  snapshot->editCount = 0;
+  pthread_mutex_unlock(&snapshot->lock);
+  for (int i = 0; i < count; i++)
+    gbWrite(gb, edits[i].address, edits[i].value);
+
+  int back = 1 - atomic_load(&snapshot->front);
+  if (atomic_load(&snapshot->reading) == back)
+    return;
+  copyBus(gb->mem, snapshot->buffers[back]);
+  atomic_store(&snapshot->front, back);
+}
+
+/* Sets a bit for every byte that differs, returns how many did */
+static size_t diff(const byte *a, const byte *b, uint64_t *bits, size_t n) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; i += 64) {
+    uint64_t same = 0;
+#ifdef __SSE2__
+    for (int j = 0; j < 4; j++) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(a + i + j * 16));
+      __m128i y = _mm_loadu_si128((const __m128i *)(b + i + j * 16));
+      uint64_t mask = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+      same |= mask << (j * 16);
+    }
+#else
+    for (int j = 0; j < 64; j++)
+      same |= (uint64_t)(a[i + j] == b[i + j]) << j;
+#endif
+    bits[i / 64] = ~same;
+    count += (size_t)__builtin_popcountll(~same);
+  }
+  return count;
+}
+
+static void track(GBMemSnapshot *snapshot, const byte *view) {
+  uint32_t now = ++snapshot->views;
+  if (now == 1) {
+    /* nothing to compare with yet */
+    memcpy(snapshot->previous, view, 0x10000);
+    return;
+  }
+  snapshot->changedCount =
+      diff(snapshot->previous, view, snapshot->changed, 0x10000);
+  if (snapshot->changedCount == 0)
+    return;
+  /* sparse: a frame touches a few hundred bytes of the 64K */
+  for (size_t i = 0; i < 0x10000 / 64; i++)
+    for (uint64_t bits = snapshot->changed[i]; bits != 0; bits &= bits - 1)
+      snapshot->changedAt[i * 64 + (size_t)__builtin_ctzll(bits)] = now;
+  memcpy(snapshot->previous, view, 0x10000);
+}
+
+const byte *gbMemSnapshotAcquire(GBMemSnapshot *snapshot) {
+  int front;
+  /* recheck so a publish can't have started on the buffer being claimed */
+  do {
+    front = atomic_load(&snapshot->front);
+    atomic_store(&snapshot->reading, front);
+  } while (atomic_load(&snapshot->front) != front);
+  snapshot->view = snapshot->buffers[front];
+  track(snapshot, snapshot->view);
+  return snapshot->view;
+}
+
+void gbMemSnapshotRelease(GBMemSnapshot *snapshot) {
+  atomic_store(&snapshot->reading, -1);
+}
+
+byte gbMemSnapshotPeek(const GBMemSnapshot *snapshot, addr address) {
+  return snapshot->view[address];
+}
+
+uint32_t gbMemSnapshotAge(const GBMemSnapshot *snapshot, addr address) {
+  uint32_t at = snapshot->changedAt[address];
+  return at == UINT32_MAX ? UINT32_MAX : snapshot->views - at;
+}
+
+int gbMemSnapshotWrite(GBMemSnapshot *snapshot, addr address, byte value) {
+  pthread_mutex_lock(&snapshot->lock);
+  if (snapshot->editCount == GB_SNAPSHOT_EDITS) {
+    pthread_mutex_unlock(&snapshot->lock);
+    gbSetError("<<gbMemSnapshotWrite>> more than %d edits pending",
+               GB_SNAPSHOT_EDITS);
+    return 1;
+  }
+  snapshot->edits[snapshot->editCount++] = (GBMemEdit){address, value};
+  pthread_mutex_unlock(&snapshot->lock);
+  return 0;
+}
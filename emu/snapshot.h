@@ -0,0 +1,61 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * A copy of the whole 64K bus for viewers on another thread or just outside
+ * the frame loop. The emulation side calls gbMemSnapshotPublish between frames
+ * to copy the bus into the back buffer and flip it to the front; a viewer
+ * brackets its reads with Acquire/Release and is never blocked or torn. While
+ * a viewer holds the only other buffer a publish is skipped, so it only ever
+ * sees a stale frame. Writes are queued and replayed through gbWrite by the
+ * next publish, so they land between frames with the same effect as a CPU
+ * store (mapper registers in ROM space, I/O side effects).
+ *
+ * Acquire also diffs the view against the previous one into a bitmap and
+ * stamps the changed addresses, so a viewer can ask how many frames ago any
+ * byte last changed.
+ */
+
+#define GB_SNAPSHOT_EDITS 256
+
+typedef struct {
+  addr address;
+  byte value;
+} GBMemEdit;
+
+typedef struct {
+  byte buffers[2][0x10000];
+  atomic_int front;   /* buffer viewers acquire */
+  atomic_int reading; /* buffer a viewer holds, -1 for none */
+  const byte *view;   /* what Acquire returned, for gbMemSnapshotPeek */
+
+  pthread_mutex_t lock; /* guards the queue */
+  GBMemEdit edits[GB_SNAPSHOT_EDITS];
+  int editCount;
+
+  /* change tracking, viewer side */
+  byte previous[0x10000];
+  uint64_t changed[0x10000 / 64]; /* previous acquire to this one */
+  size_t changedCount;
+  uint32_t views; /* acquires so far */
+  uint32_t changedAt[0x10000]; /* view number of the last change */
+} GBMemSnapshot;
+
+GBMemSnapshot *gbMemSnapshotNew(void);
+void gbMemSnapshotFree(GBMemSnapshot *snapshot);
+
+/* Emulation side, only between frames */
+void gbMemSnapshotPublish(GBMemSnapshot *snapshot, GB *gb);
+
+/* Viewer side */
+const byte *gbMemSnapshotAcquire(GBMemSnapshot *snapshot);
+void gbMemSnapshotRelease(GBMemSnapshot *snapshot);
+byte gbMemSnapshotPeek(const GBMemSnapshot *snapshot, addr address);
+/* Acquires since address last changed, UINT32_MAX if it never did */
+uint32_t gbMemSnapshotAge(const GBMemSnapshot *snapshot, addr address);
+int gbMemSnapshotWrite(GBMemSnapshot *snapshot, addr address, byte value);
@@ -0,0 +1,297 @@
+#include "state.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "blip.h"
+
+#define TAG(a, b, c, d)                                                        \
+  ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) |              \
+   ((uint32_t)(d) << 24))
+
+#define STATE_MAGIC TAG('G', 'B', 'S', 'T')
+#define STATE_BYTE_ORDER 0x01020304
+
+typedef enum {
+  CHUNK_CORE,
+  CHUNK_CPU,
+  CHUNK_MEM,
+  CHUNK_MAP,
+  CHUNK_PPU,
+  CHUNK_TIMER,
+  CHUNK_APU,
+  CHUNK_SRAM, /* cartridge RAM, as long as the cart's */
+  CHUNK_COUNT
+} Chunk;
+
+static const uint32_t ChunkTags[CHUNK_COUNT] = {
+    TAG('C', 'O', 'R', 'E'), TAG('C', 'P', 'U', ' '), TAG('M', 'E', 'M', ' '),
+    TAG('M', 'A', 'P', ' '), TAG('P', 'P', 'U', ' '), TAG('T', 'I', 'M', ' '),
+    TAG('A', 'P', 'U', ' '), TAG('S', 'R', 'A', 'M'),
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t size; /* whole state, header included */
+} StateHeader;
+
+typedef struct {
+  uint32_t tag;
+  uint32_t length;
+} ChunkHeader;
+
+typedef struct {
+  uint64_t cycles;
+  uint64_t frame;
+  byte buttons;
+} CoreChunk;
+
+typedef struct {
+  GBMapper mapper;
+  uint64_t cartSize; /* identifies the cartridge together with the checksum */
+  word cartChecksum;
+  bool bootRom;
+} MapChunk;
+
+static const uint32_t ChunkLengths[CHUNK_COUNT] = {
+    sizeof(CoreChunk), sizeof(GBCpu), GB_MEM_RAM_SIZE,
+    sizeof(MapChunk),  sizeof(GBPpu), sizeof(GBTimer), sizeof(GBApu),
+    0,
+};
+
+static uint32_t chunkLength(const GB *gb, Chunk id) {
+  if (id == CHUNK_SRAM)
+    return (uint32_t)gb->mem->sramSize;
+  return ChunkLengths[id];
+}
+
+static word cartChecksum(const GBMemory *mem) {
+  if (mem->cart == NULL)
+    return 0;
+  return (word)((mem->cart[0x14E] << 8) | mem->cart[0x14F]);
+}
+
+size_t gbStateSize(const GB *gb) {
+  size_t size = sizeof(StateHeader);
+  for (int i = 0; i < CHUNK_COUNT; i++)
+    size += sizeof(ChunkHeader) + chunkLength(gb, i);
+  return size;
+}
+
+size_t gbStateRamOffset(const GB *gb) {
+  size_t offset = sizeof(StateHeader);
+  for (int i = 0; i < CHUNK_MEM; i++)
+    offset += sizeof(ChunkHeader) + chunkLength(gb, i);
+  return offset + sizeof(ChunkHeader);
+}
+
+static byte *putChunk(const GB *gb, byte *p, Chunk id, const void *data) {
+  ChunkHeader chunk = {ChunkTags[id], chunkLength(gb, id)};
+  memcpy(p, &chunk, sizeof(chunk));
+  if (chunk.length > 0) /* data is NULL for an empty SRAM chunk */
+    memcpy(p + sizeof(chunk), data, chunk.length);
+  return p + sizeof(chunk) + chunk.length;
+}
+
+size_t gbStateSave(const GB *gb, byte *buf, size_t size) {
+  size_t total = gbStateSize(gb);
+  if (size < total)
+    return 0;
+
+  StateHeader header = {STATE_MAGIC, GB_STATE_VERSION, STATE_BYTE_ORDER,
+                        (uint32_t)total};
+  memcpy(buf, &header, sizeof(header));
+  byte *p = buf + sizeof(header);
+
+  CoreChunk core;
+  memset(&core, 0, sizeof(core));
+  core.cycles = gb->cycles;
+  core.frame = gb->frame;
+  core.buttons = gb->buttons;
+
+  MapChunk map;
+  memset(&map, 0, sizeof(map));
+  map.mapper = gb->mem->mapper;
+  map.cartSize = gb->mem->cartSize;
+  map.cartChecksum = cartChecksum(gb->mem);
+  map.bootRom = gb->mem->bootRom;
+
+  p = putChunk(gb, p, CHUNK_CORE, &core);
+  p = putChunk(gb, p, CHUNK_CPU, &gb->cpu);
+  p = putChunk(gb, p, CHUNK_MEM, gb->mem->ram);
+  p = putChunk(gb, p, CHUNK_MAP, &map);
+  p = putChunk(gb, p, CHUNK_PPU, &gb->ppu);
+  p = putChunk(gb, p, CHUNK_TIMER, &gb->timer);
+  p = putChunk(gb, p, CHUNK_APU, &gb->apu);
+  p = putChunk(gb, p, CHUNK_SRAM, gb->mem->sram);
+
+  return (size_t)(p - buf);
+}
+
+int gbStateLoad(GB *gb, const byte *buf, size_t size) {
+  StateHeader header;
+  if (size < sizeof(header)) {
+    gbSetError("<<gbStateLoad>> truncated header");
+    return 1;
+  }
+  memcpy(&header, buf, sizeof(header));
+  if (header.magic != STATE_MAGIC || header.byteOrder != STATE_BYTE_ORDER) {
+    gbSetError("<<gbStateLoad>> not a save state");
+    return 1;
+  }
+  if (header.version != GB_STATE_VERSION) {
+    gbSetError("<<gbStateLoad>> unsupported version %u", header.version);
+    return 1;
+  }
+  if (header.size > size) {
+    gbSetError("<<gbStateLoad>> truncated state");
+    return 1;
+  }
+
+  /* Validate everything before touching gb so a bad state leaves it intact */
+  const byte *chunks[CHUNK_COUNT] = {NULL};
+
+  const byte *p = buf + sizeof(header);
+  const byte *end = buf + header.size;
+  while (p + sizeof(ChunkHeader) <= end) {
+    ChunkHeader chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+    p += sizeof(chunk);
+    if (chunk.length > (size_t)(end - p)) {
+      gbSetError("<<gbStateLoad>> truncated chunk");
+      return 1;
+    }
+    for (int i = 0; i < CHUNK_COUNT; i++) {
+      if (chunk.tag != ChunkTags[i])
+        continue;
+      if (chunk.length != chunkLength(gb, i)) {
+        gbSetError("<<gbStateLoad>> chunk %.4s has length %u, expected %u",
+                   (const char *)&ChunkTags[i], chunk.length,
+                   chunkLength(gb, i));
+        return 1;
+      }
+      chunks[i] = p;
+    }
+    p += chunk.length;
+  }
+  for (int i = 0; i < CHUNK_COUNT; i++) {
+    if (chunks[i] == NULL) {
+      gbSetError("<<gbStateLoad>> missing chunk %.4s",
+                 (const char *)&ChunkTags[i]);
+      return 1;
+    }
+  }
+
+  MapChunk map;
+  memcpy(&map, chunks[CHUNK_MAP], sizeof(map));
+  if (map.cartSize != gb->mem->cartSize ||
+      map.cartChecksum != cartChecksum(gb->mem)) {
+    gbSetError("<<gbStateLoad>> state belongs to a different cartridge");
+    return 1;
+  }
+
+  CoreChunk core;
+  memcpy(&core, chunks[CHUNK_CORE], sizeof(core));
+  gb->cycles = core.cycles;
+  gb->frame = core.frame;
+  gb->buttons = core.buttons;
+
+  memcpy(&gb->cpu, chunks[CHUNK_CPU], sizeof(GBCpu));
+  memcpy(gb->mem->ram, chunks[CHUNK_MEM], GB_MEM_RAM_SIZE);
+  gbMemMarkAllDirty(gb->mem);
+  gb->mem->mapper = map.mapper;
+  gb->mem->bootRom = map.bootRom;
+  memcpy(&gb->ppu, chunks[CHUNK_PPU], sizeof(GBPpu));
+  memcpy(&gb->timer, chunks[CHUNK_TIMER], sizeof(GBTimer));
+  memcpy(&gb->apu, chunks[CHUNK_APU], sizeof(GBApu));
+  /* Compared first so a battery file's pages are only dirtied by real
+   * changes, run-ahead and rewind load states every frame */
+  GBMemory *mem = gb->mem;
+  if (mem->sramSize > 0 &&
+      memcmp(mem->sram, chunks[CHUNK_SRAM], mem->sramSize) != 0) {
+    memcpy(mem->sram, chunks[CHUNK_SRAM], mem->sramSize);
+    mem->sramDirty = true;
+  }
+  if (gb->blip != NULL)
+    gbBlipSetTime(gb->blip, gb->apu.time);
+  return 0;
+}
+
+/* Filled through a mapping of path.tmp, which only replaces path once it is
+ * on disk, so a crash or full disk midway leaves the previous state intact */
+int gbStateSaveFile(const GB *gb, const char *path) {
+  size_t size = gbStateSize(gb);
+
+  size_t length = strlen(path);
+  char *temp = malloc(length + sizeof(".tmp"));
+  if (temp == NULL) {
+    gbSetError("<<gbStateSaveFile>> out of memory");
+    return 1;
+  }
+  memcpy(temp, path, length);
+  memcpy(temp + length, ".tmp", sizeof(".tmp"));
+
+  int fd = open(temp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    gbSetError("<<gbStateSaveFile>> cannot open %s", temp);
+    free(temp);
+    return 1;
+  }
+
+  byte *map = ftruncate(fd, (off_t)size) == 0
+                  ? mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0)
+                  : MAP_FAILED;
+  if (map == MAP_FAILED) {
+    gbSetError("<<gbStateSaveFile>> cannot map %s", temp);
+    close(fd);
+    unlink(temp);
+    free(temp);
+    return 1;
+  }
+  gbStateSave(gb, map, size);
+  munmap(map, size);
+
+  /* the data has to be on disk before the rename makes it the file */
+  bool synced = fsync(fd) == 0;
+  if (close(fd) != 0 || !synced || rename(temp, path) != 0) {
+    gbSetError("<<gbStateSaveFile>> cannot write %s", path);
+    unlink(temp);
+    free(temp);
+    return 1;
+  }
+  free(temp);
+  return 0;
+}
+
+int gbStateLoadFile(GB *gb, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    gbSetError("<<gbStateLoadFile>> cannot open %s", path);
+    return 1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    gbSetError("<<gbStateLoadFile>> cannot stat %s", path);
+    close(fd);
+    return 1;
+  }
+
+  byte *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    gbSetError("<<gbStateLoadFile>> cannot map %s", path);
+    return 1;
+  }
+
+  int err = gbStateLoad(gb, map, (size_t)st.st_size);
+  munmap(map, (size_t)st.st_size);
+  return err;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gb.h"
+
+/*
+ * Save states are a small header followed by tagged chunks:
+ *
+ *   header: "GBST" | u32 version | u32 0x01020304 (byte order) | u32 size
+ *   chunk:  u32 tag | u32 length | payload
+ *
+ * Payloads are the core structs copied verbatim in host byte order, so saving
+ * and loading is a handful of memcpys. Bump GB_STATE_VERSION whenever one of
+ * those structs changes layout; loaders skip chunks they don't know and reject
+ * known chunks whose length doesn't match.
+ */
+
+#define GB_STATE_VERSION 4
+
+size_t gbStateSize(const GB *gb);
+
+/* Returns the number of bytes written, 0 if buf is too small */
+size_t gbStateSave(const GB *gb, byte *buf, size_t size);
+int gbStateLoad(GB *gb, const byte *buf, size_t size);
+
+/* Where ram sits inside a saved state, for consumers that patch dirty pages */
+size_t gbStateRamOffset(const GB *gb);
+
+int gbStateSaveFile(const GB *gb, const char *path);
+int gbStateLoadFile(GB *gb, const char *path);
@@ -0,0 +1,74 @@
+#include "timer.h"
+
+#include "gb.h"
+
+/* Divider bit whose falling edge clocks TIMA, indexed by TAC & 3 */
+static const small TimerBits[4] = {9, 3, 5, 7};
+
+/* Cycles between two falling edges of the selected divider bit */
+static word period(byte tac) { return (word)(2 << TimerBits[tac & 3]); }
+
+static void clockTima(GB *gb, uint64_t edges) {
+  byte *ram = gb->mem->ram;
+  while (edges > 0) {
+    unsigned left = 256 - ram[GB_IO_TIMA];
+    if (edges < left) {
+      ram[GB_IO_TIMA] = (byte)(ram[GB_IO_TIMA] + edges);
+      return;
+    }
+    edges -= left;
+    ram[GB_IO_TIMA] = ram[GB_IO_TMA];
+    gbRequestInterrupt(gb, GB_INT_TIMER);
+  }
+}
+
+static void advance(GB *gb) {
+  GBTimer *timer = &gb->timer;
+  byte *ram = gb->mem->ram;
+  byte tac = ram[GB_IO_TAC];
+  uint64_t elapsed = gb->cycles - timer->time;
+
+  /* Every multiple of the period the divider passes is a falling edge */
+  if (tac & 0x04)
+    clockTima(gb, (timer->div % period(tac) + elapsed) / period(tac));
+  timer->div = (word)(timer->div + elapsed);
+  timer->time = gb->cycles;
+  ram[GB_IO_DIV] = timer->div >> 8;
+}
+
+static void schedule(GB *gb) {
+  GBTimer *timer = &gb->timer;
+  const byte *ram = gb->mem->ram;
+  byte tac = ram[GB_IO_TAC];
+
+  if (!(tac & 0x04)) {
+    timer->next = UINT64_MAX;
+    return;
+  }
+  /* TIMA overflows on the (256 - TIMA)th falling edge from now */
+  word p = period(tac);
+  timer->next = timer->time - timer->div % p +
+                (uint64_t)(256 - ram[GB_IO_TIMA]) * p;
+}
+
+void gbTimerSync(GB *gb) {
+  advance(gb);
+  schedule(gb);
+}
+
+void gbTimerWrite(GB *gb, addr address, byte value) {
+  byte *ram = gb->mem->ram;
+  advance(gb);
+
+  if (address == GB_IO_DIV) {
+    /* Resetting the divider is a falling edge if the selected bit was set */
+    byte tac = ram[GB_IO_TAC];
+    if ((tac & 0x04) && (gb->timer.div & (period(tac) >> 1)))
+      clockTima(gb, 1);
+    gb->timer.div = 0;
+    ram[GB_IO_DIV] = 0;
+  } else {
+    gbMemWrite(gb->mem, address, value);
+  }
+  schedule(gb);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "common.h"
+#include "mem.h"
+
+/* DIV and TIMA are only brought up to date when the CPU reads or writes the
+ * timer registers, the only event scheduled is the next TIMA overflow */
+typedef struct {
+  word div;      /* 16-bit internal divider, DIV is its upper byte */
+  uint64_t time; /* cycle the divider has been advanced to */
+  uint64_t next; /* cycle of the next TIMA overflow, UINT64_MAX if stopped */
+} GBTimer;
+
+struct GB;
+
+/* Advances DIV and TIMA to the current cycle and reschedules the overflow */
+void gbTimerSync(struct GB *gb);
+void gbTimerWrite(struct GB *gb, addr address, byte value);
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "driver/headless/driver.h"
+#include "emu/gb.h"
+#include "emu/hotspot.h"
+#include "emu/itrace.h"
+#include "emu/movie.h"
+#include "emu/runahead.h"
+#include "emu/state.h"
+
+#define WIDTH GB_LCD_WIDTH
+#define HEIGHT GB_LCD_HEIGHT
+
+#define ITRACE_RECORDS (1 << 20)
+
+static const byte Palette[4] = {0xFF, 0xAA, 0x55, 0x00};
+
+static void blit(GBDriver *driver, const byte *shades) {
+  byte *px = driver->framebuffer;
+  for (int i = 0; i < WIDTH * HEIGHT; i++) {
+    byte v = Palette[shades[i]];
+    px[0] = px[1] = px[2] = v;
+    px[3] = 0xFF;
+    px += GB_DRIVER_CHANNELS;
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-n frames] [-i script] [-r out.raw] [-p out%%05u.ppm] "
+          "[-l state] [-s state] [-a frames [-A]] [-m movie | -M movie] "
+          "[-x itrace] [-t trace.json [-T frames]] [rom]\n"
+          "  -n  quit after this many frames (default 600, 0 = never, or\n"
+          "      the end of the movie when replaying)\n"
+          "  -i  scripted input, one \"<frame> <buttons>\" entry per line\n"
+          "  -r  append every frame as raw BGRA to a single file\n"
+          "  -p  write every frame as a PPM, path is a printf pattern\n"
+          "  -l  load a save state before the first frame\n"
+          "  -s  write a save state after the last frame\n"
+          "  -a  show frames emulated this far ahead of the real one\n"
+          "  -A  emulate them on a second instance on another core\n"
+          "  -m  replay a movie until it ends, ignoring other input\n"
+          "  -M  record input to a movie\n"
+          "  -x  keep the last 1M instructions in a file for gb_itrace\n"
+          "  -t  write a Chrome trace of the first -T frames (default 120)\n"
+#ifdef GB_HOTSPOTS
+          "  -H  write an opcode and PC hotspot report at exit\n"
+          "  -F  write hotspots as folded stacks at exit\n"
+#endif
+          ,
+          prog);
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t frames = 600;
+  bool framesGiven = false;
+  const char *script = NULL;
+  const char *dump = NULL;
+  GBDriverDumpFormat dumpFormat = GB_DUMP_NONE;
+  const char *loadState = NULL;
+  const char *saveState = NULL;
+  int runAhead = 0;
+  bool runAheadThreaded = false;
+  const char *replay = NULL;
+  const char *record = NULL;
+  const char *itrace = NULL;
+  const char *trace = NULL;
+  uint32_t traceFrames = 120;
+  const char *hotspotReport = NULL;
+  const char *hotspotFolded = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:i:r:p:l:s:a:Am:M:x:t:T:H:F:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      frames = (uint32_t)strtoul(optarg, NULL, 10);
+      framesGiven = true;
+      break;
+    case 'i':
+      script = optarg;
+      break;
+    case 'r':
+      dump = optarg;
+      dumpFormat = GB_DUMP_RAW;
+      break;
+    case 'p':
+      dump = optarg;
+      dumpFormat = GB_DUMP_PPM;
+      break;
+    case 'l':
+      loadState = optarg;
+      break;
+    case 's':
+      saveState = optarg;
+      break;
+    case 'a':
+      runAhead = atoi(optarg);
+      break;
+    case 'A':
+      runAheadThreaded = true;
+      break;
+    case 'm':
+      replay = optarg;
+      break;
+    case 'M':
+      record = optarg;
+      break;
+    case 'x':
+      itrace = optarg;
+      break;
+    case 't':
+      trace = optarg;
+      break;
+    case 'T':
+      traceFrames = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'H':
+      hotspotReport = optarg;
+      break;
+    case 'F':
+      hotspotFolded = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  GB *gb = gbNew();
+  if (gb == NULL) {
+    printf("gbNew error: %s\n", gbGetError());
+    return 1;
+  }
+  if (optind < argc && gbLoadRomFile(gb, argv[optind]) != 0) {
+    printf("gbLoadRomFile error: %s\n", gbGetError());
+    return 1;
+  }
+  if (loadState != NULL && gbStateLoadFile(gb, loadState) != 0) {
+    printf("gbStateLoadFile error: %s\n", gbGetError());
+    return 1;
+  }
+
+  GBMovie *movie = NULL;
+  if (replay != NULL) {
+    movie = gbMovieLoadFile(replay);
+    if (movie == NULL || gbMovieStart(movie, gb) != 0) {
+      printf("gbMovieLoadFile error: %s\n", gbGetError());
+      return 1;
+    }
+  } else if (record != NULL && (movie = gbMovieNew(gb)) == NULL) {
+    printf("gbMovieNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  if (itrace != NULL &&
+      (gb->itrace = gbITraceNew(itrace, ITRACE_RECORDS)) == NULL) {
+    printf("gbITraceNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+#ifdef GB_HOTSPOTS
+  if ((hotspotReport != NULL || hotspotFolded != NULL) &&
+      (gb->hotspots = gbHotspotsNew(gb)) == NULL) {
+    printf("gbHotspotsNew error: %s\n", gbGetError());
+    return 1;
+  }
+#else
+  if (hotspotReport != NULL || hotspotFolded != NULL) {
+    printf("built without GB_HOTSPOTS\n");
+    return 1;
+  }
+#endif
+
+  GBRunAhead *ahead = gbRunAheadNew(gb, runAhead, runAheadThreaded);
+  if (ahead == NULL) {
+    printf("gbRunAheadNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  gbDriverInit();
+  GBDriver *driver = gbDriverNew(WIDTH, HEIGHT);
+  if (driver == NULL) {
+    printf("gbDriverNew error: %s\n", gbGetError());
+    return 1;
+  }
+  driver->maxFrames = framesGiven || replay == NULL ? frames : 0;
+
+  if (script != NULL && gbDriverLoadScript(driver, script) != 0) {
+    printf("gbDriverLoadScript error: %s\n", gbGetError());
+    return 1;
+  }
+  if (dump != NULL && gbDriverSetDump(driver, dumpFormat, dump) != 0) {
+    printf("gbDriverSetDump error: %s\n", gbGetError());
+    return 1;
+  }
+
+  gbTraceSetThreadName("main");
+  if (trace != NULL)
+    gbTraceStart(traceFrames);
+
+  GBDriverEvent e;
+  int quit = 0;
+  while (!quit) {
+    if (gbTraceFrame() && gbTraceWrite(trace) != 0) {
+      printf("gbTraceWrite error: %s\n", gbGetError());
+      return 1;
+    }
+    GB_TRACE_BEGIN("frame");
+
+    while (gbDriverPollEvent(driver, &e) != 0) {
+      if (e.type == GB_DRIVER_QUIT)
+        quit = true;
+      if (e.type == GB_DRIVER_INPUT && record != NULL)
+        gbMovieSetButtons(movie, gb, e.buttons);
+      else if (e.type == GB_DRIVER_INPUT && replay == NULL)
+        gbSetButtons(gb, e.buttons);
+    }
+    if (quit || (replay != NULL && gbMovieFinished(movie, gb)))
+      break;
+
+    if (replay != NULL) {
+      gbMovieRunFrame(movie, gb);
+      blit(driver, gbGetFramebuffer(gb));
+    } else {
+      gbRunAheadFrame(ahead, gb);
+      blit(driver, gbRunAheadFramebuffer(ahead));
+    }
+
+    GB_TRACE_BEGIN("draw");
+    int err = gbDriverDraw(driver);
+    GB_TRACE_END("draw");
+    if (err != 0) {
+      printf("gbDriverDraw error: %s\n", gbGetError());
+      return 1;
+    }
+    GB_TRACE_END("frame");
+  }
+
+  if (gbTraceStop() && gbTraceWrite(trace) != 0) {
+    printf("gbTraceWrite error: %s\n", gbGetError());
+    return 1;
+  }
+
+  if (saveState != NULL && gbStateSaveFile(gb, saveState) != 0) {
+    printf("gbStateSaveFile error: %s\n", gbGetError());
+    return 1;
+  }
+
+#ifdef GB_HOTSPOTS
+  if (hotspotReport != NULL &&
+      gbHotspotsWriteReport(gb->hotspots, hotspotReport, 100) != 0) {
+    printf("gbHotspotsWriteReport error: %s\n", gbGetError());
+    return 1;
+  }
+  if (hotspotFolded != NULL &&
+      gbHotspotsWriteFolded(gb->hotspots, hotspotFolded) != 0) {
+    printf("gbHotspotsWriteFolded error: %s\n", gbGetError());
+    return 1;
+  }
+#endif
+
+  if (record != NULL && gbMovieSaveFile(movie, gb, record) != 0) {
+    printf("gbMovieSaveFile error: %s\n", gbGetError());
+    return 1;
+  }
+
+  gbDriverFree(driver);
+
+  gbDriverQuit();
+
+  if (movie != NULL)
+    gbMovieFree(movie);
+  gbRunAheadFree(ahead);
+  gbFree(gb);
+  gbTraceShutdown();
+
+  return 0;
+}
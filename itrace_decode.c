@@ -0,0 +1,107 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "emu/disasm.h"
+#include "emu/itrace.h"
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-n count] [-c] [-d] trace.bin\n"
+          "Prints the instruction trace oldest first, one line per\n"
+          "instruction in the Gameboy Doctor format.\n"
+          "  -n  only the last count instructions\n"
+          "  -c  prefix every line with the cycle counter and bank:pc\n"
+          "  -d  append the disassembled instruction\n",
+          prog);
+}
+
+static void printRecord(const GBITraceRecord *r, bool cycles, bool disasm) {
+  if (cycles)
+    printf("%12llu %02X:%04X ", (unsigned long long)r->cycle, r->bank, r->pc);
+  printf("A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X "
+         "PC:%04X PCMEM:%02X,%02X,%02X,%02X",
+         r->af >> 8, r->af & 0xFF, r->bc >> 8, r->bc & 0xFF, r->de >> 8,
+         r->de & 0xFF, r->hl >> 8, r->hl & 0xFF, r->sp, r->pc, r->pcmem[0],
+         r->pcmem[1], r->pcmem[2], r->pcmem[3]);
+  if (disasm) {
+    GBInstruction in;
+    gbDecode(r->pcmem, r->pc, &in);
+    printf(" %s", in.text);
+  }
+  putchar('\n');
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t last = UINT64_MAX;
+  bool cycles = false;
+  bool disasm = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:cdh")) != -1) {
+    switch (opt) {
+    case 'n':
+      last = strtoull(optarg, NULL, 10);
+      break;
+    case 'c':
+      cycles = true;
+      break;
+    case 'd':
+      disasm = true;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const char *path = argv[optind];
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 1;
+  }
+  size_t size = (size_t)st.st_size;
+  const byte *map = size >= sizeof(GBITraceHeader)
+                        ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                        : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "cannot map %s\n", path);
+    return 1;
+  }
+
+  /* capacity is checked against the file size by division so a corrupt
+   * header can't overflow the product */
+  const GBITraceHeader *header = (const GBITraceHeader *)map;
+  uint64_t capacity = header->capacity;
+  if (header->magic != GB_ITRACE_MAGIC ||
+      header->version != GB_ITRACE_VERSION ||
+      header->recordSize != sizeof(GBITraceRecord) || capacity == 0 ||
+      (capacity & (capacity - 1)) != 0 ||
+      capacity > (size - sizeof(GBITraceHeader)) / sizeof(GBITraceRecord)) {
+    fprintf(stderr, "%s is not a version %d instruction trace\n", path,
+            GB_ITRACE_VERSION);
+    return 1;
+  }
+
+  const GBITraceRecord *records = (const GBITraceRecord *)(header + 1);
+  uint64_t end = header->written;
+  uint64_t start = end > capacity ? end - capacity : 0;
+  if (end - start > last)
+    start = end - last;
+  for (uint64_t i = start; i < end; i++)
+    printRecord(&records[i & (capacity - 1)], cycles, disasm);
+
+  munmap((void *)map, size);
+  return 0;
+}
@@ -2,7 +2,9 @@
 
 #define NO_STDIO_REDIRECT
 #include <SDL.h>
+#include <float.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define CIMGUI_DEFINE_ENUMS_AND_STRUCTS
 #include <cimgui.h>
@@ -10,8 +12,18 @@
 
 #include "common.h"
 #include "driver/gl/shader.h"
+#include "driver/gl/vram.h"
 #include "driver/sdl/driver.h"
-#include "emu/mem.h"
+#include "emu/blip.h"
+#include "emu/debug.h"
+#include "emu/disasm.h"
+#include "emu/gb.h"
+#include "emu/movie.h"
+#include "emu/rewind.h"
+#include "emu/runahead.h"
+#include "emu/search.h"
+#include "emu/snapshot.h"
+#include "emu/state.h"
 
 #include "driver/imgui/memory_view.h"
 
@@ -24,10 +36,501 @@
 
 #define FPS 59.727500569606
 
+#define REWIND_BUDGET (16 * 1024 * 1024)
+#define REWIND_STATES (30 * 60) // 30 seconds
+
+#define RUN_AHEAD_FRAMES 1
+
+#define PROFILE_CSV "profile.csv"
+
+#define FRAME_ARENA (64 * 1024)
+
+#define CHANGE_FRAMES 30
+
+#define SEARCH_RESULTS 64
+
+#define DISASM_ROWS 24
+#define DISASM_CONTEXT 24 // bytes of code shown before PC
+
+#define AUDIO_RATE 48000
+#define AUDIO_BLIP 4096           // frames synthesized between host frames
+#define AUDIO_RING (2048 * 2 * 2) // bytes, about 43ms of stereo frames
+#define AUDIO_SKEW 0.005          // most the sample rate is nudged either way
+#define AUDIO_GAIN 0.02           // skew per unit of fill away from half
+#define AUDIO_LOW 0.1             // fill below which an extra frame is run
+#define AUDIO_HIGH 0.9            // fill above which a frame is skipped
+
+#define BATTERY_SYNC 1000 // ms between writebacks of a dirty .sav
+
+#define TRACE_FRAMES 120
+#define TRACE_JSON "trace.json"
+
+static const byte Palette[4] = {0xFF, 0xAA, 0x55, 0x00};
+
+static void uploadScreen(GLuint texture, const byte *shades) {
+  static byte rgba[GB_LCD_WIDTH * GB_LCD_HEIGHT * CHANNELS];
+  byte *px = rgba;
+  for (int i = 0; i < GB_LCD_WIDTH * GB_LCD_HEIGHT; i++) {
+    byte v = Palette[shades[i]];
+    px[0] = px[1] = px[2] = v;
+    px[3] = 0xFF;
+    px += CHANNELS;
+  }
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GB_LCD_WIDTH, GB_LCD_HEIGHT, GL_RGBA,
+                  GL_UNSIGNED_BYTE, rgba);
+}
+
+/* The memory editor browses the bus through a snapshot taken between frames */
+static ImU8 busPeek(const ImU8 *data, size_t off) {
+  return gbMemSnapshotPeek((const GBMemSnapshot *)data, (addr)off);
+}
+
+static void busPoke(ImU8 *data, size_t off, ImU8 d) {
+  if (gbMemSnapshotWrite((GBMemSnapshot *)data, (addr)off, d) != 0)
+    printf("gbMemSnapshotWrite error: %s\n", gbGetError());
+}
+
+/* Bytes that changed recently, fading out over CHANGE_FRAMES */
+static bool busChanged(const ImU8 *data, size_t off) {
+  return gbMemSnapshotAge((const GBMemSnapshot *)data, (addr)off) <
+         CHANGE_FRAMES;
+}
+
+static ImU32 busChangeColor(const ImU8 *data, size_t off) {
+  uint32_t age = gbMemSnapshotAge((const GBMemSnapshot *)data, (addr)off);
+  return IM_COL32(255, 160, 0, 160 * (CHANGE_FRAMES - age) / CHANGE_FRAMES);
+}
+
+static void drawSearch(GBSearch *search, const byte *view,
+                       GBMemoryEditor *editor) {
+  static bool wide;
+  static int op, value;
+
+  igBegin("Search", NULL, 0);
+  igCheckbox("16-bit", &wide);
+  igComboStr_arr("##op", &op, gbSearchOpNames, GB_SEARCH_OP_COUNT, -1);
+  if (op == GB_SEARCH_EQUAL || op == GB_SEARCH_NOT_EQUAL)
+    igInputInt("Value", &value, 1, 16, 0);
+  if (igButton("New search", (ImVec2){0, 0}))
+    gbSearchReset(search, view, wide);
+  igSameLine(0.0f, -1.0f);
+  if (igButton("Filter", (ImVec2){0, 0}))
+    gbSearchFilter(search, view, (GBSearchOp)op, (word)value);
+  igText("%zu candidates", search->count);
+
+  addr results[SEARCH_RESULTS];
+  size_t n = gbSearchResults(search, results, SEARCH_RESULTS);
+  for (size_t i = 0; i < n; i++) {
+    addr at = results[i];
+    unsigned v = search->wide ? (unsigned)(view[at] | view[at + 1] << 8)
+                              : view[at];
+    char label[32];
+    snprintf(label, sizeof(label), "%04X: %u", at, v);
+    if (igSelectableBool(label, false, 0, (ImVec2){0, 0}))
+      meditGotoAddrAndHighlight(editor, at, at + 1 + search->wide);
+  }
+  igEnd();
+}
+
+static const char *BreakReasons[] = {"running", "breakpoint", "read",
+                                     "write", "step"};
+
+/* Hex address input, true with the parsed address once Enter is pressed */
+static bool inputAddr(const char *label, char *buf, addr *out) {
+  unsigned value;
+  ImVec2 size;
+  igCalcTextSize(&size, "FFFF_", NULL, false, -1.0f);
+  igPushItemWidth(size.x);
+  bool entered = igInputText(label, buf, 5,
+                             ImGuiInputTextFlags_CharsHexadecimal |
+                                 ImGuiInputTextFlags_EnterReturnsTrue,
+                             NULL, NULL);
+  igPopItemWidth();
+  if (sscanf(buf, "%X", &value) != 1)
+    return false;
+  *out = (addr)value;
+  return entered;
+}
+
+static void drawDebugger(GB *gb) {
+  GBDebug *debug = gb->debug;
+  static char pcBuf[5], startBuf[5], endBuf[5];
+  static bool watchRead, watchWrite = true;
+
+  igBegin("Debugger", NULL, 0);
+  GBRegisters *r = &gb->cpu.regs;
+  if (debug->reason == GB_BREAK_NONE) {
+    igText("Running");
+    igSameLine(0.0f, -1.0f);
+    if (igButton("Break", (ImVec2){0, 0}))
+      gbDebugStep(debug);
+  } else {
+    igText("Stopped (%s %04X) at PC %04X", BreakReasons[debug->reason],
+           debug->address, r->pc);
+    igText("AF %04X BC %04X DE %04X HL %04X SP %04X", r->af, r->bc, r->de,
+           r->hl, r->sp);
+    if (igButton("Continue", (ImVec2){0, 0}))
+      gbDebugContinue(debug);
+    igSameLine(0.0f, -1.0f);
+    if (igButton("Step", (ImVec2){0, 0}))
+      gbDebugStep(debug);
+  }
+
+  igSeparator();
+  addr pc = 0;
+  bool add = inputAddr("##pc", pcBuf, &pc);
+  igSameLine(0.0f, -1.0f);
+  add |= igButton("Add breakpoint", (ImVec2){0, 0});
+  if (add && pcBuf[0] != '\0')
+    gbDebugSetBreakpoint(debug, pc, true);
+  for (int i = 0; i < 0x10000 / 64; i++) {
+    for (uint64_t bits = debug->breakpoints[i]; bits != 0; bits &= bits - 1) {
+      addr bp = (addr)(i * 64 + __builtin_ctzll(bits));
+      igPushIDInt(bp);
+      if (igButton("x", (ImVec2){0, 0}))
+        gbDebugSetBreakpoint(debug, bp, false);
+      igSameLine(0.0f, -1.0f);
+      igText("PC %04X", bp);
+      igPopID();
+    }
+  }
+
+  igSeparator();
+  addr start = 0, end = 0;
+  bool hasStart = inputAddr("##start", startBuf, &start);
+  igSameLine(0.0f, -1.0f);
+  inputAddr("##end", endBuf, &end);
+  if (endBuf[0] == '\0')
+    end = start;
+  igSameLine(0.0f, -1.0f);
+  igCheckbox("R", &watchRead);
+  igSameLine(0.0f, -1.0f);
+  igCheckbox("W", &watchWrite);
+  igSameLine(0.0f, -1.0f);
+  add = igButton("Add watchpoint", (ImVec2){0, 0}) || hasStart;
+  byte kind =
+      (watchRead ? GB_WATCH_READ : 0) | (watchWrite ? GB_WATCH_WRITE : 0);
+  if (add && startBuf[0] != '\0' &&
+      gbDebugAddWatchpoint(debug, start, end, kind) != 0)
+    printf("gbDebugAddWatchpoint error: %s\n", gbGetError());
+  for (int i = 0; i < debug->watchpointCount; i++) {
+    const GBWatchpoint *w = &debug->watchpoints[i];
+    igPushIDInt(i);
+    if (igButton("x", (ImVec2){0, 0}))
+      gbDebugRemoveWatchpoint(debug, i);
+    igSameLine(0.0f, -1.0f);
+    igText("%04X-%04X %s%s", w->start, w->end,
+           w->kind & GB_WATCH_READ ? "R" : "",
+           w->kind & GB_WATCH_WRITE ? "W" : "");
+    igPopID();
+  }
+  igEnd();
+}
+
+/*
+ * Earliest address at most back bytes before to whose linear decode lands
+ * exactly on to, to itself when none does
+ */
+static addr disasmBack(GBDisasm *disasm, const GBMemory *mem,
+                       const byte *view, int bank, addr to, int back) {
+  for (; back > 0; back--) {
+    int offset = 0;
+    while (offset < back) {
+      const GBInstruction *in =
+          gbDisasmAt(disasm, mem, view, bank, (addr)(to - back + offset));
+      if (in == NULL)
+        return to;
+      offset += in->length;
+    }
+    if (offset == back)
+      return (addr)(to - back);
+  }
+  return to;
+}
+
+static void drawDisassembly(GB *gb, GBDisasm *disasm, const byte *view) {
+  static bool follow = true;
+  static char gotoBuf[5];
+  static addr top;
+  static int bank = -1;
+  const GBMemory *mem = gb->mem;
+  addr pc = gb->cpu.regs.pc;
+
+  igBegin("Disassembly", NULL, 0);
+  igCheckbox("Follow PC", &follow);
+  igSameLine(0.0f, -1.0f);
+  addr to;
+  if (inputAddr("##goto", gotoBuf, &to)) {
+    top = to;
+    follow = false;
+  }
+  igSameLine(0.0f, -1.0f);
+  igPushItemWidth(80.0f);
+  igInputInt("Bank (-1 mapped)", &bank, 1, 1, 0);
+  igPopItemWidth();
+  if (bank < -1)
+    bank = -1;
+  int shown = follow ? -1 : bank;
+
+  if (follow) {
+    top = disasmBack(disasm, mem, view, shown, pc, DISASM_CONTEXT);
+  } else if (igIsWindowHovered(0) && igGetIO()->MouseWheel != 0) {
+    const GBInstruction *in = gbDisasmAt(disasm, mem, view, shown, top);
+    if (igGetIO()->MouseWheel > 0)
+      top = disasmBack(disasm, mem, view, shown, top, 3);
+    else if (in != NULL)
+      top = (addr)(top + in->length);
+  }
+
+  addr at = top;
+  for (int row = 0; row < DISASM_ROWS; row++) {
+    const GBInstruction *in = gbDisasmAt(disasm, mem, view, shown, at);
+    if (in == NULL)
+      break;
+    char label[16], targetLabel[16] = "";
+    if (gbDisasmLabel(disasm, mem, shown, at, label))
+      igText("%s:", label);
+    if (in->hasTarget &&
+        gbDisasmLabel(disasm, mem, shown, in->target, targetLabel + 3))
+      memcpy(targetLabel, " ; ", 3);
+
+    char hex[10] = "";
+    for (int i = 0; i < in->length; i++)
+      snprintf(hex + i * 3, sizeof(hex) - (size_t)i * 3, "%02X ", in->bytes[i]);
+    bool breakpoint = gbDebugHasBreakpoint(gb->debug, at);
+    char line[80];
+    snprintf(line, sizeof(line), "%c%c %04X  %-9s %s%s", at == pc ? '>' : ' ',
+             breakpoint ? '*' : ' ', at, hex, in->text, targetLabel);
+    // clicking a line toggles a breakpoint on it
+    if (igSelectableBool(line, at == pc, 0, (ImVec2){0, 0}))
+      gbDebugSetBreakpoint(gb->debug, at, !breakpoint);
+    at = (addr)(at + in->length);
+  }
+  igEnd();
+}
+
+static void image(GLuint texture, int width, int height, float scale) {
+  igImage((ImTextureID)(intptr_t)texture,
+          (ImVec2){width * scale, height * scale}, (ImVec2){0, 0},
+          (ImVec2){1, 1}, (ImVec4){1, 1, 1, 1}, (ImVec4){0, 0, 0, 0});
+}
+
+static void drawVram(GBVramViewer *viewer, const byte *view) {
+  GB_PROFILE_BEGIN(GB_PROFILE_UPLOAD);
+  GB_TRACE_BEGIN("vram viewer");
+  gbVramViewerUpdate(viewer, view);
+  GB_TRACE_END("vram viewer");
+  GB_PROFILE_END();
+
+  igBegin("VRAM", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+  igText("%d uploads this frame", viewer->uploads);
+  image(viewer->tiles, GB_VRAM_TILES_WIDTH, GB_VRAM_TILES_HEIGHT, 2);
+  igSameLine(0.0f, -1.0f);
+  image(viewer->sprites, GB_VRAM_SPRITES_WIDTH, GB_VRAM_SPRITES_HEIGHT, 2);
+  for (int map = 0; map < 2; map++) {
+    image(viewer->maps[map], GB_VRAM_MAP_SIZE, GB_VRAM_MAP_SIZE, 1);
+    if (map == 0)
+      igSameLine(0.0f, -1.0f);
+  }
+  igEnd();
+}
+
+// game.gb -> game.sav, next to the ROM
+static void romPath(const char *rom, const char *ext, char *out, size_t size) {
+  snprintf(out, size, "%s", rom);
+  char *dot = strrchr(out, '.');
+  char *slash = strrchr(out, '/');
+  if (dot != NULL && (slash == NULL || dot > slash))
+    *dot = '\0';
+  strncat(out, ext, size - strlen(out) - 1);
+}
+
+// Hands data over to the writer thread, which frees it once written. Encode
+// into a local first, size is only set once the encoder has run
+static void writeLater(GBWriter *writer, const char *path, void *data,
+                       size_t size) {
+  if (data == NULL) {
+    printf("%s not written: %s\n", path, gbGetError());
+    return;
+  }
+  if (gbWriterWrite(writer, path, data, size) != 0) {
+    printf("gbWriterWrite error: %s\n", gbGetError());
+    free(data);
+  }
+}
+
+static byte *encodeState(const GB *gb, size_t *size) {
+  *size = gbStateSize(gb);
+  byte *state = malloc(*size);
+  if (state == NULL) {
+    gbSetError("<<encodeState>> out of memory");
+    return NULL;
+  }
+  gbStateSave(gb, state, *size);
+  return state;
+}
+
+static byte *encodePpm(const byte *shades, size_t *size) {
+  char header[32];
+  int length = snprintf(header, sizeof(header), "P6\n%d %d\n255\n",
+                        GB_LCD_WIDTH, GB_LCD_HEIGHT);
+  *size = (size_t)length + GB_FRAMEBUFFER_SIZE * 3;
+  byte *ppm = malloc(*size);
+  if (ppm == NULL) {
+    gbSetError("<<encodePpm>> out of memory");
+    return NULL;
+  }
+  memcpy(ppm, header, (size_t)length);
+  byte *rgb = ppm + length;
+  for (int i = 0; i < GB_FRAMEBUFFER_SIZE; i++)
+    memset(rgb + i * 3, Palette[shades[i] & 3], 3);
+  return ppm;
+}
+
+static double audioFill(GBRing *ring) {
+  return 1.0 - (double)gbRingSpace(ring) / AUDIO_RING;
+}
+
+// Dynamic rate control: the ring is kept around half full by synthesizing
+// slightly fewer samples when it fills and slightly more when it drains, a
+// pitch change far below what is audible
+static double audioRate(GBRing *ring) {
+  double skew = AUDIO_GAIN * (audioFill(ring) - 0.5);
+  if (skew > AUDIO_SKEW)
+    skew = AUDIO_SKEW;
+  if (skew < -AUDIO_SKEW)
+    skew = -AUDIO_SKEW;
+  return AUDIO_RATE * (1.0 - skew);
+}
+
+// Frames to emulate this host frame when audio sets the pace. One per vsync
+// normally; the rate control absorbs the small difference between 59.73 Hz
+// and the display, and only a bigger mismatch drops or adds a frame
+static int audioFrames(GBRing *ring) {
+  double fill = audioFill(ring);
+  if (fill > AUDIO_HIGH)
+    return 0;
+  if (fill < AUDIO_LOW)
+    return 2;
+  return 1;
+}
+
+#ifdef GB_PROFILE
+static void drawProfiler(GBWriter *writer) {
+  igBegin("Profiler", NULL, 0);
+  for (int i = 0; i <= GB_PROFILE_COUNT; i++) {
+    const char *name = i < GB_PROFILE_COUNT ? gbProfileZoneNames[i] : "frame";
+    GBProfileStats stats = gbProfileGetStats(i);
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "min %.0f avg %.0f max %.0f us",
+             stats.min, stats.avg, stats.max);
+
+    int offset;
+    const float *history = gbProfileHistory(i, &offset);
+    igPlotLinesFloatPtr(name, history, GB_PROFILE_HISTORY, offset, overlay, 0,
+                        FLT_MAX, (ImVec2){0, 40}, sizeof(float));
+  }
+  if (igButton("Dump CSV", (ImVec2){0, 0})) {
+    size_t size;
+    char *csv = gbProfileSerializeCsv(&size);
+    writeLater(writer, PROFILE_CSV, csv, size);
+  }
+  igEnd();
+}
+#endif
+
 int main(int a, char *b[]) {
-  GBMemory *mem = gbMemNew();
+  GB *gb = gbNew();
+  if (gb == NULL) {
+    printf("gbNew error: %s\n", gbGetError());
+    return 1;
+  }
+  if (a > 1 && gbLoadRomFile(gb, b[1]) != 0) {
+    printf("gbLoadRomFile error: %s\n", gbGetError());
+    return 1;
+  }
+
+  // disk writes go through the writer thread, never this one
+  GBWriter *writer = gbWriterNew();
+  if (writer == NULL) {
+    printf("gbWriterNew error: %s\n", gbGetError());
+    return 1;
+  }
+  char statePath[GB_WRITER_PATH] = "gb.state";
+  if (a > 1)
+    romPath(b[1], ".state", statePath, sizeof(statePath));
+
+  // cartridge RAM lives in the .sav file itself, see gbMemMapBattery
+  char battery[GB_WRITER_PATH] = "";
+  if (gb->mem->battery) {
+    romPath(b[1], ".sav", battery, sizeof(battery));
+    if (gbMemMapBattery(gb->mem, battery) != 0) {
+      printf("gbMemMapBattery error: %s\n", gbGetError());
+      return 1;
+    }
+  }
+
+  // gb rom [movie]: record every input change to movie until exit
+  GBMovie *movie = NULL;
+  if (a > 2 && (movie = gbMovieNew(gb)) == NULL) {
+    printf("gbMovieNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  GBRewind *history = gbRewindNew(gb, REWIND_BUDGET, REWIND_STATES);
+  if (history == NULL) {
+    printf("gbRewindNew error: %s\n", gbGetError());
+    return 1;
+  }
+  bool rewinding = false;
+
+  int runAhead = RUN_AHEAD_FRAMES;
+  GBRunAhead *ahead = gbRunAheadNew(gb, runAhead, true);
+  if (ahead == NULL) {
+    printf("gbRunAheadNew error: %s\n", gbGetError());
+    return 1;
+  }
 
-  GBMemoryEditor *mem_edit = meditMemoryEditorNew();
+  if ((gb->debug = gbDebugNew()) == NULL) {
+    printf("gbDebugNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  GBMemSnapshot *bus = gbMemSnapshotNew();
+  if (bus == NULL) {
+    printf("gbMemSnapshotNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  // scratch for the debugger panels, reset every frame
+  GBArena *frameArena = gbArenaNew(FRAME_ARENA);
+  if (frameArena == NULL) {
+    printf("gbArenaNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  GBMemoryEditor *mem_edit = meditMemoryEditorNew(frameArena);
+  if (mem_edit == NULL) {
+    printf("meditMemoryEditorNew error: %s\n", gbGetError());
+    return 1;
+  }
+  mem_edit->ReadFn = busPeek;
+  mem_edit->WriteFn = busPoke;
+  mem_edit->HighlightFn = busChanged;
+  mem_edit->HighlightColorFn = busChangeColor;
+
+  GBDisasm *disasm = gbDisasmNew(gb);
+  if (disasm == NULL) {
+    printf("gbDisasmNew error: %s\n", gbGetError());
+    return 1;
+  }
+
+  GBSearch *search = gbSearchNew();
+  if (search == NULL) {
+    printf("gbSearchNew error: %s\n", gbGetError());
+    return 1;
+  }
 
   gbDriverInit();
   GBDriver *driver = gbDriverNew(WIDTH, HEIGHT);
@@ -38,6 +541,21 @@ int main(int a, char *b[]) {
     return 1;
   }
 
+  gb->blip = gbBlipNew(GB_CLOCK_RATE, AUDIO_RATE, AUDIO_BLIP);
+  GBRing *audio = gbRingNew(AUDIO_RING);
+  if (gb->blip == NULL || audio == NULL) {
+    printf("audio error: %s\n", gbGetError());
+    return 1;
+  }
+  gbBlipSetTime(gb->blip, gb->apu.time);
+  // keep going without sound, paced by the timer, when there is no device
+  bool audioSync = true;
+  if (gbDriverOpenAudio(driver, AUDIO_RATE, audio) != 0) {
+    printf("gbDriverOpenAudio error: %s\n", gbGetError());
+    audioSync = false;
+  }
+  bool audioOpen = audioSync;
+
   if (gl3wInit()) {
     fprintf(stderr, "Failed to initialize OpenGL loader!\n");
     return 1;
@@ -67,14 +585,30 @@ int main(int a, char *b[]) {
 
   ImGui_ImplSDL2_InitForOpenGL(debugger->raw, debugger->context);
   ImGui_ImplOpenGL3_Init("#version 330");
-  gbDriverSetEventCallback(ImGui_ImplSDL2_ProcessEvent);
+  gbDriverSetEventCallback(debugger, ImGui_ImplSDL2_ProcessEvent);
 
   igStyleColorsDark(NULL);
+  gbTraceSetThreadName("main");
+
+  GLuint screen;
+  glGenTextures(1, &screen);
+  glBindTexture(GL_TEXTURE_2D, screen);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, GB_LCD_WIDTH, GB_LCD_HEIGHT, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  GBVramViewer *vram = gbVramViewerNew(Palette);
+  if (vram == NULL) {
+    printf("gbVramViewerNew error: %s\n", gbGetError());
+    return 1;
+  }
 
   double tickInteval = 1000. / FPS; // frequency in Hz to period in ms
   uint32_t lastUpdateTime = 0;
   uint32_t deltaTime = 0;
   uint32_t accumulator = 0;
+  uint32_t lastBatterySync = 0;
 
   ImVec4 clearColor;
   clearColor.x = 0.45f;
@@ -85,23 +619,105 @@ int main(int a, char *b[]) {
   GBDriverEvent e;
   int quit = 0;
   while (!quit) {
-    while (gbDriverPollEvent(&e) != 0) {
+    GB_PROFILE_FRAME();
+    gbArenaReset(frameArena);
+    if (gbTraceFrame()) {
+      size_t size;
+      char *json = gbTraceSerialize(&size);
+      writeLater(writer, TRACE_JSON, json, size);
+    }
+    GB_TRACE_BEGIN("frame");
+
+    GBWriterResult written;
+    while (gbWriterPoll(writer, &written)) {
+      if (written.error != 0)
+        printf("cannot write %s: %s\n", written.path,
+               strerror(written.error));
+      else if (strcmp(written.path, battery) != 0)
+        printf("wrote %s\n", written.path);
+    }
+
+    while (gbDriverPollEvent(debugger, &e) != 0) {
       if (e.type == GB_DRIVER_QUIT)
         quit = true;
       if (e.type == GB_DRIVER_RESIZE)
         glViewport(0, 0, e.width, e.height);
+      if (e.type == GB_DRIVER_INPUT && movie != NULL)
+        gbMovieSetButtons(movie, gb, e.buttons);
+      else if (e.type == GB_DRIVER_INPUT)
+        gbSetButtons(gb, e.buttons);
+      if (e.type == GB_DRIVER_HOTKEY && e.hotkey == GB_HOTKEY_TRACE)
+        gbTraceStart(TRACE_FRAMES);
+      if (e.type == GB_DRIVER_HOTKEY && e.hotkey == GB_HOTKEY_SAVE_STATE) {
+        size_t size;
+        byte *state = encodeState(gb, &size);
+        writeLater(writer, statePath, state, size);
+      }
+      if (e.type == GB_DRIVER_HOTKEY && e.hotkey == GB_HOTKEY_SCREENSHOT) {
+        char path[64];
+        snprintf(path, sizeof(path), "screenshot-%llu.ppm",
+                 (unsigned long long)gb->frame);
+        size_t size;
+        byte *ppm = encodePpm(gbGetFramebuffer(gb), &size);
+        writeLater(writer, path, ppm, size);
+      }
     }
 
     uint32_t currentTime = gbDriverGetTicks();
     deltaTime = currentTime - lastUpdateTime;
     accumulator += deltaTime;
 
-    while (accumulator >= tickInteval) {
-      // update
+    // rewinding makes no sound, so the ring can't pace it
+    int due = 0;
+    if (audioSync && !rewinding) {
+      due = audioFrames(audio);
+      accumulator = 0;
+    } else {
+      for (; accumulator >= tickInteval; accumulator -= tickInteval)
+        due++;
+    }
 
-      accumulator -= tickInteval;
+    bool stepped = false;
+    GB_TRACE_BEGIN("emulate");
+    for (; due > 0; due--) {
+      if (gb->debug->reason != GB_BREAK_NONE) {
+        accumulator = 0; // don't catch up on the time spent stopped
+        break;
+      }
+      if (rewinding) {
+        if (gbRewindStep(history, gb) != 0) {
+          if (history->hasCurrent)
+            printf("gbRewindStep error: %s\n", gbGetError());
+          gbRewindClear(history); // a history that can't load is useless
+          break;
+        }
+      } else {
+        gbRunAheadFrame(ahead, gb);
+        gbRewindCapture(history, gb);
+      }
+      stepped = true;
+    }
+    // whatever doesn't fit is dropped rather than queued as latency
+    int16_t samples[AUDIO_BLIP * 2];
+    size_t frames;
+    while ((frames = gbBlipRead(gb->blip, samples, AUDIO_BLIP)) > 0)
+      gbRingWrite(audio, samples, frames * sizeof(samples[0]) * 2);
+    gbBlipSetRates(gb->blip, GB_CLOCK_RATE,
+                   audioSync ? audioRate(audio) : AUDIO_RATE);
+    gbMemSnapshotPublish(bus, gb);
+    GB_TRACE_END("emulate");
+    if (stepped) {
+      const byte *shades =
+          rewinding ? gbGetFramebuffer(gb) : gbRunAheadFramebuffer(ahead);
+      GB_PROFILE_BEGIN(GB_PROFILE_UPLOAD);
+      GB_TRACE_BEGIN("upload");
+      uploadScreen(screen, shades);
+      GB_TRACE_END("upload");
+      GB_PROFILE_END();
     }
 
+    GB_PROFILE_BEGIN(GB_PROFILE_IMGUI);
+    GB_TRACE_BEGIN("imgui");
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame(debugger->raw);
     igNewFrame();
@@ -111,34 +727,101 @@ int main(int a, char *b[]) {
 
     igShowDemoWindow(1);
 
-    meditDrawWindow(mem_edit, "Memory Editor", mem->rom, GB_MEM_ROM_SIZE,
-                    0x0000);
+    igBegin("Screen", NULL, ImGuiWindowFlags_AlwaysAutoResize);
+    igImage((ImTextureID)(intptr_t)screen,
+            (ImVec2){GB_LCD_WIDTH * 2, GB_LCD_HEIGHT * 2}, (ImVec2){0, 0},
+            (ImVec2){1, 1}, (ImVec4){1, 1, 1, 1}, (ImVec4){0, 0, 0, 0});
+    igEnd();
+
+    igBegin("Rewind", NULL, 0);
+    igButton("Hold to rewind", (ImVec2){0, 0});
+    rewinding = igIsItemActive() && movie == NULL; // would break the movie
+    igText("%zu states", history->count);
+    if (igSliderInt("Run-ahead", &runAhead, 0, 4, "%d frames", 0))
+      gbRunAheadSetFrames(ahead, runAhead);
+    if (audioOpen)
+      igCheckbox("Sync to audio", &audioSync);
+    igText("audio buffer %.0f%%, %.0f Hz", audioFill(audio) * 100,
+           audioSync ? audioRate(audio) : AUDIO_RATE);
+    igEnd();
+
+    drawDebugger(gb);
+
+    const byte *view = gbMemSnapshotAcquire(bus);
+    char title[64];
+    snprintf(title, sizeof(title), "Memory Editor (%zu changed)###memory",
+             bus->changedCount);
+    meditDrawWindow(mem_edit, title, bus, 0x10000, 0x0000);
+    drawSearch(search, view, mem_edit);
+    drawDisassembly(gb, disasm, view);
+    drawVram(vram, view);
+    gbMemSnapshotRelease(bus);
+
+#ifdef GB_PROFILE
+    drawProfiler(writer);
+#endif
 
     igRender();
+    GB_TRACE_END("imgui");
+    GB_PROFILE_END();
 
     SDL_GL_MakeCurrent(debugger->raw, debugger->context);
 
     glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    GB_PROFILE_BEGIN(GB_PROFILE_IMGUI);
+    GB_TRACE_BEGIN("render debugger");
     ImGui_ImplOpenGL3_RenderDrawData(igGetDrawData());
+    GB_TRACE_END("render debugger");
+    GB_PROFILE_END();
 
     // Update screen
+    GB_PROFILE_BEGIN(GB_PROFILE_SWAP);
+    GB_TRACE_BEGIN("swap debugger");
     gbDriverDraw(debugger);
+    GB_TRACE_END("swap debugger");
+    GB_PROFILE_END();
 
     SDL_GL_MakeCurrent(driver->raw, driver->context);
 
     glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    GB_PROFILE_BEGIN(GB_PROFILE_IMGUI);
+    GB_TRACE_BEGIN("render driver");
     ImGui_ImplOpenGL3_RenderDrawData(igGetDrawData());
+    GB_TRACE_END("render driver");
+    GB_PROFILE_END();
 
     // Update screen
+    GB_PROFILE_BEGIN(GB_PROFILE_SWAP);
+    GB_TRACE_BEGIN("swap driver");
     gbDriverDraw(driver);
+    GB_TRACE_END("swap driver");
+    GB_PROFILE_END();
+
+    // the game's stores are already in the page cache, this only makes them
+    // durable, on the writer thread
+    if (currentTime - lastBatterySync >= BATTERY_SYNC) {
+      if (gb->mem->sramMapped && gb->mem->sramDirty) {
+        // stays dirty when the queue is full so the next period retries
+        if (gbWriterSync(writer, battery, gb->mem->sram,
+                         gb->mem->sramSize) != 0)
+          printf("gbWriterSync error: %s\n", gbGetError());
+        else
+          gb->mem->sramDirty = false;
+      }
+      lastBatterySync = currentTime;
+    }
 
     lastUpdateTime = currentTime;
+    GB_TRACE_END("frame");
   }
 
+  glDeleteTextures(1, &screen);
+  gbVramViewerFree(vram);
+
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   igDestroyContext(NULL);
@@ -146,8 +829,26 @@ int main(int a, char *b[]) {
   gbDriverFree(driver);
 
   gbDriverQuit();
+  gbRingFree(audio);
 
-  gbMemFree(mem);
+  gbRunAheadFree(ahead);
+  if (movie != NULL) {
+    if (gbMovieSaveFile(movie, gb, b[2]) != 0)
+      printf("gbMovieSaveFile error: %s\n", gbGetError());
+    gbMovieFree(movie);
+  }
+  gbRewindFree(history);
+  gbMemSnapshotFree(bus);
+  gbSearchFree(search);
+  gbDisasmFree(disasm);
+  meditMemoryEditorFree(mem_edit);
+  gbArenaFree(frameArena);
+  gbBlipFree(gb->blip);
+  gbWriterFree(writer); // drains, and no sync may outlive the mapping
+  if (gbMemSyncBattery(gb->mem, true) != 0)
+    printf("gbMemSyncBattery error: %s\n", gbGetError());
+  gbFree(gb);
+  gbTraceShutdown(); // every tracing thread has been joined by now
 
   return 0;
 }